@@ -171,6 +171,44 @@ std::string SdService::readFile(const std::string &filePath)
     return content;
 }
 
+std::string SdService::readFileRange(const std::string &filePath, size_t offset, size_t length)
+{
+    std::string content;
+    if (!sdCardMounted)
+    {
+        return content;
+    }
+
+    File file = SD.open(filePath.c_str(), FILE_READ);
+    if (file)
+    {
+        if (offset < file.size() && file.seek(offset))
+        {
+            content.resize(std::min(length, file.size() - offset));
+            content.resize(file.read(reinterpret_cast<uint8_t *>(&content[0]), content.size()));
+        }
+        file.close();
+    }
+    return content;
+}
+
+size_t SdService::fileSize(const std::string &filePath)
+{
+    if (!sdCardMounted)
+    {
+        return 0;
+    }
+
+    size_t size = 0;
+    File file = SD.open(filePath.c_str(), FILE_READ);
+    if (file)
+    {
+        size = file.size();
+        file.close();
+    }
+    return size;
+}
+
 bool SdService::writeFile(const std::string &filePath, const std::string &data)
 {
     if (!sdCardMounted)
@@ -236,6 +274,26 @@ bool SdService::deleteFile(const std::string &filePath)
     return false;
 }
 
+bool SdService::renameFile(const std::string &from, const std::string &to)
+{
+    if (!sdCardMounted)
+    {
+        return false;
+    }
+
+    return SD.rename(from.c_str(), to.c_str());
+}
+
+File SdService::openFile(const std::string &filePath, const char *mode)
+{
+    if (!sdCardMounted)
+    {
+        return File();
+    }
+
+    return SD.open(filePath.c_str(), mode);
+}
+
 std::string SdService::getFileExt(const std::string &path)
 {
     size_t pos = path.find_last_of('.');
@@ -31,11 +31,15 @@ public:
     std::vector<std::string> listElements(const std::string &dirPath, size_t limit = 0);
     std::vector<uint8_t> readBinaryFile(const std::string &filePath);
     std::string readFile(const std::string &filePath);
+    std::string readFileRange(const std::string &filePath, size_t offset, size_t length);
+    size_t fileSize(const std::string &filePath);
 
     bool writeFile(const std::string &filePath, const std::string &data);
     bool writeBinaryFile(const std::string &filePath, const std::vector<uint8_t> &data);
     bool appendToFile(const std::string &filePath, const std::string &data);
     bool deleteFile(const std::string &filePath);
+    bool renameFile(const std::string &from, const std::string &to);
+    File openFile(const std::string &filePath, const char *mode = FILE_READ);
     bool ensureDirectory(const std::string &directory);
 
     std::string getFileExt(const std::string &path);
@@ -0,0 +1,86 @@
+#ifndef APPSTATE_H
+#define APPSTATE_H
+
+#include <string>
+
+// The steps from power on to an open room. loop() runs the step in its
+// state, a step that fails is shown with RETRY and BACK. Going back keeps
+// what the earlier steps set up, connections and caches included.
+enum AppState
+{
+    STATE_STORAGE, // SD card
+    STATE_CONFIG,  // config file
+    STATE_WIFI,
+    STATE_ACCOUNT, // profile and login, the profile list once logged in
+    STATE_ROOMS,   // room list
+    STATE_ROOM,    // terminal
+};
+
+// The step after `state`: `next` when it succeeded, else the same step for
+// RETRY and the one before it for BACK. The SD card has nothing before it,
+// BACK retries it too.
+inline AppState afterStep(AppState state, AppState next, bool ok, bool retry)
+{
+    if (ok)
+    {
+        return next;
+    }
+    if (retry || state == STATE_STORAGE)
+    {
+        return state;
+    }
+    return AppState(state - 1);
+}
+
+// What each step does. main.cpp runs the board's, the host tests script
+// their failures. A step that fails leaves why in failure().
+class StartSteps
+{
+public:
+    virtual ~StartSteps() {}
+
+    virtual bool startStorage() = 0;
+    virtual bool loadConfig() = 0;
+    virtual bool startWifi() = 0;
+    virtual bool startAccount() = 0;
+    // Sets `next` to STATE_ROOM once a room is chosen, or to STATE_ROOMS to
+    // show the list again after one of its own screens
+    virtual bool chooseRoom(AppState &next) = 0;
+    // Returns when the room is left
+    virtual void enterRoom() = 0;
+    // Shows failure() with RETRY and BACK, true for RETRY
+    virtual bool retry() = 0;
+    virtual const std::string &failure() const = 0;
+};
+
+// Runs the step of `state` with `steps` and returns the state after it
+inline AppState runStep(StartSteps &steps, AppState state)
+{
+    AppState next = AppState(state + 1);
+    bool ok = true;
+    switch (state)
+    {
+    case STATE_STORAGE:
+        ok = steps.startStorage();
+        break;
+    case STATE_CONFIG:
+        ok = steps.loadConfig();
+        break;
+    case STATE_WIFI:
+        ok = steps.startWifi();
+        break;
+    case STATE_ACCOUNT:
+        ok = steps.startAccount();
+        break;
+    case STATE_ROOMS:
+        ok = steps.chooseRoom(next);
+        break;
+    case STATE_ROOM:
+        steps.enterRoom();
+        next = STATE_ROOMS;
+        break;
+    }
+    return afterStep(state, next, ok, ok || steps.retry());
+}
+
+#endif // APPSTATE_H
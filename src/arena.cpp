@@ -0,0 +1,80 @@
+#include "arena.h"
+#include "metrics.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// every block is preceded by its size, rounded so blocks stay aligned
+static const size_t HEADER = 8;
+
+static size_t align(size_t size) { return (size + 7) & ~(size_t)7; }
+
+Arena::Arena(size_t capacity)
+    : base((uint8_t *)malloc(capacity)), capacity(base ? capacity : 0) {}
+
+Arena::~Arena() { free(base); }
+
+void *Arena::allocate(size_t size) {
+  size_t needed = HEADER + align(size);
+  if (used + needed > capacity) {
+    metrics.add(COUNTER_ARENA_OVERFLOWS);
+    return malloc(size);
+  }
+
+  void *ptr = base + used + HEADER;
+  blockSize(ptr) = size;
+  used += needed;
+  peak = used > peak ? used : peak;
+  last = ptr;
+  return ptr;
+}
+
+void Arena::deallocate(void *ptr) {
+  if (!owns(ptr)) {
+    free(ptr);
+    return;
+  }
+  // only the newest block can be given back, the rest goes on reset()
+  if (ptr == last) {
+    used = (uint8_t *)ptr - HEADER - base;
+    last = nullptr;
+  }
+}
+
+void *Arena::reallocate(void *ptr, size_t new_size) {
+  if (!ptr) {
+    return allocate(new_size);
+  }
+  if (!owns(ptr)) {
+    return realloc(ptr, new_size);
+  }
+
+  size_t offset = (uint8_t *)ptr - base;
+  if (ptr == last && offset + align(new_size) <= capacity) {
+    blockSize(ptr) = new_size;
+    used = offset + align(new_size);
+    peak = used > peak ? used : peak;
+    return ptr;
+  }
+
+  size_t old_size = blockSize(ptr);
+  void *moved = allocate(new_size);
+  if (moved) {
+    memcpy(moved, ptr, old_size < new_size ? old_size : new_size);
+    deallocate(ptr);
+  }
+  return moved;
+}
+
+void Arena::reset() {
+  used = 0;
+  last = nullptr;
+}
+
+bool Arena::owns(const void *ptr) const {
+  return ptr >= base && ptr < base + capacity;
+}
+
+size_t &Arena::blockSize(void *ptr) const {
+  return *(size_t *)((uint8_t *)ptr - HEADER);
+}
@@ -0,0 +1,41 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <ArduinoJson.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define POLL_ARENA_SIZE 8192
+
+// Bump allocator for the temporaries of one poll cycle. The block is taken
+// from the heap once and handed out again after every reset(), so a cycle
+// that fits leaves the heap as it found it. Requests that do not fit fall
+// back to the heap. Also usable as the allocator of a JsonDocument, which
+// must be destroyed before reset() is called.
+class Arena : public ArduinoJson::Allocator
+{
+public:
+    Arena(size_t capacity = POLL_ARENA_SIZE);
+    ~Arena();
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    void *allocate(size_t size) override;
+    void deallocate(void *ptr) override;
+    void *reallocate(void *ptr, size_t new_size) override;
+
+    void reset();
+    size_t highWater() const { return peak; }
+
+private:
+    bool owns(const void *ptr) const;
+    size_t &blockSize(void *ptr) const;
+
+    uint8_t *base;
+    size_t capacity;
+    size_t used = 0;
+    size_t peak = 0;
+    void *last = nullptr;
+};
+
+#endif // ARENA_H
@@ -0,0 +1,65 @@
+#include "breaker.h"
+#include "metrics.h"
+#include "telemetry.h"
+
+#include <Arduino.h>
+
+bool CircuitBreaker::allow() {
+  std::lock_guard<std::mutex> lock(mutex);
+  switch (current) {
+  case BREAKER_CLOSED:
+    return true;
+  case BREAKER_OPEN:
+    if ((long)(millis() - probeAt) < 0) {
+      return false;
+    }
+    current = BREAKER_HALF_OPEN;
+    publishLocked();
+    return true;
+  default:
+    return false; // the probe is still out
+  }
+}
+
+void CircuitBreaker::success() {
+  std::lock_guard<std::mutex> lock(mutex);
+  failures = 0;
+  wait = BREAKER_PROBE_MIN;
+  if (current != BREAKER_CLOSED) {
+    current = BREAKER_CLOSED;
+    publishLocked();
+  }
+}
+
+void CircuitBreaker::failure() {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (current == BREAKER_OPEN) {
+    return; // a call that went out before it opened
+  }
+  if (current == BREAKER_CLOSED && ++failures < BREAKER_THRESHOLD) {
+    return;
+  }
+  if (current == BREAKER_HALF_OPEN) {
+    wait = wait * 2 > BREAKER_PROBE_MAX ? BREAKER_PROBE_MAX : wait * 2;
+  } else {
+    metrics.add(COUNTER_BREAKER_OPENS);
+  }
+  current = BREAKER_OPEN;
+  // somewhere in the last quarter of the wait
+  probeAt = millis() + wait - esp_random() % (wait / 4);
+  publishLocked();
+}
+
+BreakerState CircuitBreaker::state() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return current;
+}
+
+void CircuitBreaker::publish() {
+  std::lock_guard<std::mutex> lock(mutex);
+  publishLocked();
+}
+
+void CircuitBreaker::publishLocked() {
+  telemetry.publishBreaker(current, current == BREAKER_OPEN ? probeAt : 0);
+}
@@ -0,0 +1,48 @@
+#ifndef BREAKER_H
+#define BREAKER_H
+
+#include <mutex>
+#include <stdint.h>
+
+#define BREAKER_THRESHOLD 5     // failed calls in a row that open the breaker
+#define BREAKER_PROBE_MIN 5000  // ms an opened breaker waits before its first probe
+#define BREAKER_PROBE_MAX 60000 // each failed probe doubles the wait, up to this
+
+enum BreakerState
+{
+    BREAKER_CLOSED,    // calls go through
+    BREAKER_OPEN,      // calls fail at once until the probe wait is over
+    BREAKER_HALF_OPEN, // one probe call is out, the rest still fail
+};
+
+// Stops calls to a server that keeps failing, so a dead server costs no
+// requests and no time spent holding the user mutex. After
+// BREAKER_THRESHOLD calls in a row failed, each after its retries, the
+// breaker opens. Once the probe wait, jittered so devices do not return in
+// step, has passed a single call goes through: success closes the breaker,
+// failure opens it again for twice as long. Answers the server gives, errors included, count
+// as success.
+class CircuitBreaker
+{
+public:
+    // Whether a call may go out now, each allowed call must be followed by
+    // success() or failure()
+    bool allow();
+    void success();
+    void failure();
+
+    BreakerState state();
+    // Shows this breaker in the status bar, for when the server in use changes
+    void publish();
+
+private:
+    void publishLocked();
+
+    std::mutex mutex;
+    BreakerState current = BREAKER_CLOSED;
+    uint8_t failures = 0;
+    uint32_t wait = BREAKER_PROBE_MIN;
+    unsigned long probeAt = 0;
+};
+
+#endif // BREAKER_H
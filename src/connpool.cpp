@@ -0,0 +1,177 @@
+#include "connpool.h"
+#include "metrics.h"
+
+#include <WiFi.h>
+#include <lwip/sockets.h>
+
+#include <ctype.h>
+
+// 32 bytes of hex, the bytes may be separated by ':' or ' ' as
+// WiFiClientSecure::verify() takes them
+static bool isFingerprint(const string &text) {
+  size_t digits = 0;
+  for (char c : text) {
+    if (isxdigit((unsigned char)c)) {
+      ++digits;
+    } else if (c != ':' && c != ' ') {
+      return false;
+    }
+  }
+  return digits == 64;
+}
+
+void Cancellation::cancel() {
+  std::lock_guard<std::mutex> lock(mutex);
+  done = true;
+  // wakes the task waiting on it, the client itself is only ever stopped by
+  // the task that uses it
+  if (client && client->socket() >= 0) {
+    shutdown(client->socket(), SHUT_RDWR);
+  }
+}
+
+bool Cancellation::watch(PoolClient *client) {
+  std::lock_guard<std::mutex> lock(mutex);
+  this->client = done ? nullptr : client;
+  return !done;
+}
+
+ConnectionPool::ConnectionPool(const string &host, uint16_t port)
+    : serverHost(host), port(port) {}
+
+void ConnectionPool::setPins(const string &caCert, const string &fingerprint) {
+  std::lock_guard<std::mutex> lock(mutex);
+  this->caCert = caCert;
+  this->fingerprint = fingerprint;
+  refused = fingerprint.empty() || isFingerprint(fingerprint)
+                ? ""
+                : "Bad cert_fingerprint!";
+  // connections made under the old pins are not trusted any more
+  for (auto &slot : slots) {
+    if (!slot.busy) {
+      slot.client.stop();
+    }
+  }
+}
+
+void ConnectionPool::refuse(const string &why) {
+  std::lock_guard<std::mutex> lock(mutex);
+  refused = why;
+  for (auto &slot : slots) {
+    if (!slot.busy) {
+      slot.client.stop();
+    }
+  }
+}
+
+void ConnectionPool::closeIdle() {
+  std::lock_guard<std::mutex> lock(mutex);
+  for (auto &slot : slots) {
+    if (!slot.busy) {
+      slot.client.stop();
+    }
+  }
+}
+
+bool ConnectionPool::connect(WiFiClientSecure &client) {
+  if (!refused.empty()) {
+    metrics.add(COUNTER_REQUEST_ERRORS);
+    return false;
+  }
+  if (caCert.empty()) {
+    client.setInsecure();
+  } else {
+    client.setCACert(caCert.c_str());
+  }
+  client.setHandshakeTimeout(POOL_CONNECT_TIMEOUT / 1000);
+
+  // resolve and connect by hand so each phase can be timed, HTTPClient
+  // reuses an already connected client
+  unsigned long start = micros();
+  IPAddress ip;
+  bool resolved = WiFi.hostByName(serverHost.c_str(), ip);
+  metrics.record(TIMING_DNS, micros() - start);
+
+  start = micros();
+  bool connected = resolved && client.connect(serverHost.c_str(), port,
+                                               POOL_CONNECT_TIMEOUT);
+  metrics.record(TIMING_CONNECT, micros() - start);
+
+  if (connected && !fingerprint.empty() &&
+      !client.verify(fingerprint.c_str(), serverHost.c_str())) {
+    client.stop();
+    connected = false;
+  }
+
+  if (connected) {
+    metrics.add(COUNTER_CONNECTS);
+    if (!verified()) {
+      metrics.add(COUNTER_UNVERIFIED_CONNECTS);
+    }
+  } else {
+    metrics.add(COUNTER_REQUEST_ERRORS);
+  }
+  return connected;
+}
+
+PoolClient *ConnectionPool::acquire(bool &reused) {
+  reused = false;
+  Slot *free = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto &slot : slots) {
+      if (slot.busy) {
+        continue;
+      }
+      if (slot.client.connected() &&
+          millis() - slot.lastUsed < POOL_IDLE_TIMEOUT) {
+        slot.busy = true;
+        reused = true;
+        metrics.add(COUNTER_CONNECTIONS_REUSED);
+        return &slot.client;
+      }
+      if (!free) {
+        free = &slot;
+      }
+    }
+    if (free) {
+      free->busy = true;
+    }
+  }
+
+  if (!free) {
+    // every slot is in use, this one is closed again on release
+    PoolClient *client = new PoolClient();
+    if (!connect(*client)) {
+      delete client;
+      return nullptr;
+    }
+    return client;
+  }
+
+  // the handshake happens outside the lock, other slots stay usable
+  free->client.stop();
+  if (!connect(free->client)) {
+    std::lock_guard<std::mutex> lock(mutex);
+    free->busy = false;
+    return nullptr;
+  }
+  return &free->client;
+}
+
+void ConnectionPool::release(WiFiClientSecure *client, bool keep) {
+  std::lock_guard<std::mutex> lock(mutex);
+  for (auto &slot : slots) {
+    if (&slot.client == client) {
+      if (!keep || !client->connected()) {
+        client->stop();
+      }
+      slot.lastUsed = millis();
+      slot.busy = false;
+      return;
+    }
+  }
+
+  client->stop();
+  delete client;
+}
@@ -0,0 +1,98 @@
+#ifndef CONNPOOL_H
+#define CONNPOOL_H
+
+#include <WiFiClientSecure.h>
+
+#include <atomic>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+
+using std::string;
+
+#define POOL_SIZE 2              // kept alive TLS connections, each holds ~40 KB of heap
+#define POOL_IDLE_TIMEOUT 20000  // ms after which the server has likely closed an idle one
+#define POOL_CONNECT_TIMEOUT 5000 // ms for the TCP connect and again for the TLS handshake
+#define TLS_CA_PATH "/mjca.pem"  // CA certificate the server must chain to, PEM
+
+// A pooled client, its socket can be shut down from another task
+class PoolClient : public WiFiClientSecure
+{
+public:
+    // -1 when not connected
+    int socket() const { return sslclient ? sslclient->socket : -1; }
+};
+
+// Ends a request from another task, such as the long poll of a room that was
+// left. From cancel() on, every request watched by it fails at once.
+class Cancellation
+{
+public:
+    // Shuts down the socket of the request in flight, if there is one
+    void cancel();
+    bool cancelled() const { return done; }
+    // The client of the request in flight, nullptr once it is over and
+    // before the client goes back to the pool. False when already cancelled.
+    bool watch(PoolClient *client);
+
+private:
+    std::mutex mutex;
+    PoolClient *client = nullptr;
+    std::atomic<bool> done{false};
+};
+
+// TLS connections to one server, kept open between requests so only the
+// first one pays for the handshake. The server is checked against a pinned
+// CA and/or certificate fingerprint when set, otherwise it is not verified.
+// Pins that were configured but are unusable refuse every connection rather
+// than fall back to an unverified one.
+class ConnectionPool
+{
+public:
+    ConnectionPool(const string &host, uint16_t port = 443);
+
+    // `caCert` in PEM, `fingerprint` the SHA-256 of the server certificate
+    // in hex. Either may be empty. A fingerprint that is not 32 bytes of hex
+    // refuses connections.
+    void setPins(const string &caCert, const string &fingerprint);
+    // Refuses connections until the next setPins(), for a pin that is
+    // configured but could not be read
+    void refuse(const string &why);
+    // Why connections are refused, empty when they are not
+    const string &refusal() const { return refused; }
+    // Whether connections check the server at all
+    bool verified() const { return !caCert.empty() || !fingerprint.empty(); }
+
+    // A connected client, `reused` when it was kept from an earlier request.
+    // nullptr when connecting failed. Hand it back with release().
+    PoolClient *acquire(bool &reused);
+    // Keeps the client for the next request when `keep` and it is still
+    // connected, closes it otherwise
+    void release(WiFiClientSecure *client, bool keep);
+
+    // Closes the kept connections nobody is using, their heap is better
+    // spent elsewhere while the server is not talked to
+    void closeIdle();
+
+    // Connects a client the pool does not own, with the same checks
+    bool connect(WiFiClientSecure &client);
+    const string &host() const { return serverHost; }
+
+private:
+    struct Slot
+    {
+        PoolClient client;
+        bool busy = false;
+        unsigned long lastUsed = 0;
+    };
+
+    Slot slots[POOL_SIZE];
+    std::mutex mutex;
+    string serverHost;
+    uint16_t port;
+    string caCert;
+    string fingerprint;
+    string refused;
+};
+
+#endif // CONNPOOL_H
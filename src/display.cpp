@@ -1,6 +1,13 @@
 #include "display.h"
+#include "breaker.h"
 #include "input.h"
+#include "lineeditor.h"
+#include "metrics.h"
+#include "telemetry.h"
+#include "textlayout.h"
+#include "utf8.h"
 
+#include <algorithm>
 #include <memory>
 #include <vector>
 
@@ -45,38 +52,57 @@ void displayStart(bool selected)
     M5.Lcd.print("START SERIAL");
 };
 
-void displayTerminal(std::string receiveString, size_t scroll)
+static TextLayout layout;
+
+void displaySetGlyphs(GlyphCache *glyphs)
+{
+    layout.setGlyphs(glyphs);
+}
+
+// Row of the terminal, a span of the terminal string
+struct TerminalRow
+{
+    size_t start;
+    size_t length;
+};
+
+static std::vector<TerminalRow> wrapTerminalLines(const std::string &receiveString)
 {
-    const uint8_t charsPerLine = 39;
-    const uint8_t linesPerScreen = 12;
+    layout.setTextSize(1);
+    const int32_t rowWidth = M5.Lcd.width();
 
-    // Split receiveString by \n and wrap text
-    std::vector<std::string> lines;
-    std::string currentLine;
-    for (size_t i = 0; i < receiveString.length(); ++i)
+    // Split receiveString by \n and wrap each line on word boundaries
+    std::vector<TerminalRow> rows;
+    size_t lineStart = 0;
+    while (lineStart < receiveString.length())
     {
-        char c = receiveString[i];
-        if (c == '\n')
+        size_t lineEnd = receiveString.find('\n', lineStart);
+        if (lineEnd == std::string::npos)
         {
-            lines.push_back(currentLine); // Add the current line and reset
-            currentLine.clear();
+            lineEnd = receiveString.length();
         }
-        else
+
+        const char *line = receiveString.c_str() + lineStart;
+        for (const LineSpan &span : layout.wrap(line, lineEnd - lineStart, rowWidth))
         {
-            currentLine += c;
-            // If the current line exceeds the allowed number of characters per line, wrap it
-            if (currentLine.length() >= charsPerLine)
-            {
-                lines.push_back(currentLine);
-                currentLine.clear();
-            }
+            rows.push_back(TerminalRow{lineStart + span.start, span.length});
         }
+        lineStart = lineEnd + 1;
     }
-    // Push the last remaining part of the string (if any)
-    if (!currentLine.empty())
-    {
-        lines.push_back(currentLine);
-    }
+    return rows;
+}
+
+size_t displayLineCount(const std::string &terminalString)
+{
+    return wrapTerminalLines(terminalString).size();
+}
+
+size_t displayTerminal(std::string receiveString, size_t scroll)
+{
+    ScopedTiming timing(TIMING_RENDER_TERMINAL);
+    const uint8_t linesPerScreen = TERMINAL_LINES;
+
+    std::vector<TerminalRow> lines = wrapTerminalLines(receiveString);
 
     // Now, calculate the number of lines and only display the last ones that fit on the screen
     // and move it for scroll
@@ -96,27 +122,187 @@ void displayTerminal(std::string receiveString, size_t scroll)
 
     // Clear the terminal view before displaying the new content
     displayClearTerminalView();
-    M5.Lcd.setCursor(0, DEFAULT_MARGIN);
-    M5.Lcd.setTextSize(1);
+    layout.setTextColor(TEXT_COLOR);
 
-    // Print only the visible portion of the terminal string
+    // Draw only the visible portion of the terminal string, one run per row
+    int32_t y = STATUS_BAR_HEIGHT + 1;
     for (size_t i = startLine; i < endLine; ++i)
     {
-        M5.Lcd.println(lines[i].c_str());
+        layout.draw(receiveString.c_str() + lines[i].start, lines[i].length, 0, y);
+        y += layout.lineHeight();
+    }
+
+    return totalLines;
+}
+
+void displayTerminalNotice(std::string notice)
+{
+    // One line banner over the top of the terminal, cleared by the next redraw
+    M5.Lcd.fillRect(0, STATUS_BAR_HEIGHT, M5.Lcd.width(), DEFAULT_MARGIN + 10, RECT_COLOR_DARK);
+    M5.Lcd.setTextSize(1);
+    M5.Lcd.setTextColor(PRIMARY_COLOR);
+    M5.Lcd.setCursor(DEFAULT_MARGIN, STATUS_BAR_HEIGHT + DEFAULT_MARGIN);
+    M5.Lcd.print(notice.c_str());
+    M5.Lcd.setTextColor(TEXT_COLOR);
+}
+
+enum StatusField
+{
+    STATUS_LINK,
+    STATUS_BATTERY,
+    STATUS_QUEUE,
+    STATUS_SYNC,
+    STATUS_FIELDS
+};
+
+// Left edge of each field, the last entry is the right edge of the bar
+static const int16_t STATUS_FIELD_X[STATUS_FIELDS + 1] = {2, 50, 86, 130, 238};
+static std::string statusShown[STATUS_FIELDS];
+
+static std::string formatAge(uint32_t ms)
+{
+    uint32_t seconds = ms / 1000;
+    if (seconds < 60)
+    {
+        return std::to_string(seconds) + "s";
+    }
+    if (seconds < 3600)
+    {
+        return std::to_string(seconds / 60) + "m";
+    }
+    return std::to_string(seconds / 3600) + "h";
+}
+
+void displayStatusBar(bool full)
+{
+    TelemetrySnapshot status = telemetry.snapshot();
+    uint32_t now = millis();
+    bool stuck = status.lastPoll && now - status.lastPoll > TELEMETRY_STUCK_AFTER;
+    bool down = status.breaker != BREAKER_CLOSED;
+
+    std::string text[STATUS_FIELDS];
+    text[STATUS_LINK] = status.connected ? std::to_string(status.rssi) + "dBm" : "offline";
+    text[STATUS_BATTERY] = status.battery >= 0 ? std::to_string(status.battery) + "%" : "";
+    text[STATUS_QUEUE] = status.queued ? std::to_string(status.queued) + " out" : "";
+    if (status.breaker == BREAKER_OPEN)
+    {
+        int32_t left = (int32_t)(status.probeAt - now);
+        text[STATUS_SYNC] = "down, retry " + formatAge(left > 0 ? left : 0);
+    }
+    else if (status.breaker == BREAKER_HALF_OPEN)
+    {
+        text[STATUS_SYNC] = "retrying";
+    }
+    else if (stuck)
+    {
+        text[STATUS_SYNC] = "stuck " + formatAge(now - status.lastPoll);
+    }
+    else if (status.lastSync)
+    {
+        text[STATUS_SYNC] = "sync " + formatAge(now - status.lastSync) + " ago";
+    }
+
+    if (full)
+    {
+        M5.Lcd.fillRect(0, 0, M5.Lcd.width(), STATUS_BAR_HEIGHT, RECT_COLOR_DARK);
+    }
+
+    layout.setTextSize(1);
+    for (int i = 0; i < STATUS_FIELDS; ++i)
+    {
+        if (!full && text[i] == statusShown[i])
+        {
+            continue;
+        }
+
+        int16_t x = STATUS_FIELD_X[i];
+        M5.Lcd.fillRect(x, 0, STATUS_FIELD_X[i + 1] - x, STATUS_BAR_HEIGHT, RECT_COLOR_DARK);
+        bool alert = (i == STATUS_SYNC && (stuck || down)) || (i == STATUS_LINK && !status.connected);
+        layout.setTextColor(alert ? PRIMARY_COLOR : TEXT_COLOR);
+        layout.draw(text[i].c_str(), text[i].size(), x, 1);
+        statusShown[i].swap(text[i]);
+    }
+    layout.setTextColor(TEXT_COLOR);
+}
+
+// What an editor line on screen shows, so a keystroke only repaints from the
+// first glyph that changed
+struct EditorView
+{
+    size_t start = 0; // first byte of the text in view
+    std::string shown;
+    int32_t cursorX = -1;
+};
+
+static void drawEditorLine(const LineEditor &editor, EditorView &view, int32_t left, int32_t right,
+                           int32_t y, bool full)
+{
+    const int32_t available = right - left;
+    const size_t cursor = editor.cursor();
+
+    // Scroll the view just enough to keep the cursor in it
+    if (cursor < view.start)
+    {
+        view.start = cursor;
+    }
+    else
+    {
+        std::string before = editor.slice(view.start, cursor);
+        view.start += layout.fitTail(before, available - 1);
+    }
+
+    // 160 bytes is more than a row holds at any text size
+    std::string visible = editor.slice(view.start, std::min(editor.size(), view.start + 160));
+    visible.erase(layout.fitHead(visible.data(), visible.size(), available));
+    int32_t cursorX = left + layout.width(visible.data(), cursor - view.start) - 1;
+
+    size_t same = 0;
+    if (!full)
+    {
+        while (same < visible.size() && same < view.shown.size() && visible[same] == view.shown[same])
+        {
+            ++same;
+        }
+        while (same > 0 && same < visible.size() && (visible[same] & 0xc0) == 0x80)
+        {
+            --same;
+        }
+    }
+
+    int32_t x = left + layout.width(visible.data(), same);
+    if (!full && view.cursorX >= 0 && view.cursorX < x)
+    {
+        M5.Lcd.drawFastVLine(view.cursorX, y - 1, layout.lineHeight() + 1, RECT_COLOR_DARK);
+    }
+    if (full || same < visible.size() || same < view.shown.size())
+    {
+        M5.Lcd.fillRect(x, y - 1, right - x + 1, layout.lineHeight() + 2, RECT_COLOR_DARK);
+        layout.draw(visible.data() + same, visible.size() - same, x, y);
     }
+    M5.Lcd.drawFastVLine(cursorX, y - 1, layout.lineHeight() + 1, PRIMARY_COLOR);
+
+    view.shown.swap(visible);
+    view.cursorX = cursorX;
 }
 
-void displayPrompt(std::string sendString)
+static EditorView promptView;
+
+void displayPrompt(const LineEditor &editor, bool full)
 {
+    ScopedTiming timing(TIMING_RENDER_PROMPT);
 
-    if (sendString.length() > 26)
+    layout.setTextSize(1);
+    if (full)
     {
-        sendString = sendString.substr(sendString.length() - 26);
+        drawRect(false, DEFAULT_MARGIN, 110, M5.Lcd.width() - 15, 25);
+        layout.setTextColor(TEXT_COLOR);
+        layout.draw(" > ", 3, DEFAULT_MARGIN * 2, 118);
     }
-    drawRect(false, DEFAULT_MARGIN, 110, M5.Lcd.width() - 15, 25);
-    M5.Lcd.setCursor(DEFAULT_MARGIN * 2, 118);
-    M5.Lcd.print(" > ");
-    M5.Lcd.print(sendString.c_str());
+    layout.setTextColor(TEXT_COLOR);
+
+    int32_t left = DEFAULT_MARGIN * 2 + layout.width(" > ", 3);
+    int32_t right = M5.Lcd.width() - 15 + DEFAULT_MARGIN - 3;
+    drawEditorLine(editor, promptView, left, right, 118, full);
 }
 
 void drawRect(bool selected, uint8_t margin, uint16_t startY, uint16_t sizeX, uint16_t sizeY)
@@ -142,7 +328,8 @@ void displayClearMainView(uint8_t offsetY)
 
 void displayClearTerminalView()
 {
-    M5.Lcd.fillRect(0, 0, M5.Lcd.width(), M5.Lcd.height() - 30, BACKGROUND_COLOR);
+    M5.Lcd.fillRect(0, STATUS_BAR_HEIGHT, M5.Lcd.width(), M5.Lcd.height() - 27 - STATUS_BAR_HEIGHT,
+                    BACKGROUND_COLOR);
 }
 
 void showMessage(std::string message)
@@ -166,18 +353,95 @@ void showMessage(std::string message)
     M5.Lcd.printf(message.c_str());
 }
 
-unsigned int selectFromList(std::vector<std::string> items, unsigned int startIndex)
+#define LIST_ROWS 5        // rows on screen, the last one partly
+#define LIST_ROW_HEIGHT 30
+
+static bool lessNoCase(const std::string &a, const std::string &b, size_t length)
 {
-    uint8_t selectedIndex = startIndex;
-    bool selectionMade = false;
-    bool firstRender = true;
+    for (size_t i = 0; i < length; ++i)
+    {
+        if (i == a.size() || i == b.size())
+        {
+            return a.size() < b.size() && i == a.size();
+        }
+        int ca = tolower((unsigned char)a[i]);
+        int cb = tolower((unsigned char)b[i]);
+        if (ca != cb)
+        {
+            return ca < cb;
+        }
+    }
+    return false;
+}
 
-    M5.Lcd.setTextColor(TEXT_COLOR);
-    M5.Lcd.setTextSize(1.5);
+// Items sorted without regard to case, so the items starting with a filter
+// are one contiguous range found by binary search
+class PrefixIndex
+{
+public:
+    PrefixIndex(const std::vector<std::string> &items) : items(items) {}
 
-    while (!selectionMade)
+    // Indexes of the items starting with `prefix`, in list order
+    void match(const std::string &prefix, std::vector<size_t> &out)
     {
+        if (sorted.empty())
+        {
+            sorted.resize(items.size());
+            for (size_t i = 0; i < sorted.size(); ++i)
+            {
+                sorted[i] = i;
+            }
+            std::stable_sort(sorted.begin(), sorted.end(), [this](size_t a, size_t b) {
+                return lessNoCase(this->items[a], this->items[b], SIZE_MAX);
+            });
+        }
+
+        size_t length = prefix.size();
+        auto first = std::lower_bound(sorted.begin(), sorted.end(), prefix, [&](size_t i, const std::string &p) {
+            return lessNoCase(items[i], p, length);
+        });
+        auto last = std::upper_bound(first, sorted.end(), prefix, [&](const std::string &p, size_t i) {
+            return lessNoCase(p, items[i], length);
+        });
+        out.assign(first, last);
+        std::sort(out.begin(), out.end());
+    }
+
+private:
+    const std::vector<std::string> &items;
+    std::vector<size_t> sorted; // built on the first keystroke
+};
 
+static void drawListRow(const std::string &item, size_t row, bool selected)
+{
+    int32_t y = DEFAULT_MARGIN + row * LIST_ROW_HEIGHT;
+    int32_t width = M5.Lcd.width() - 15;
+    drawRect(selected, DEFAULT_MARGIN, y, width, 25);
+    layout.setTextColor(TEXT_COLOR);
+    layout.draw(item.c_str(), layout.fitHead(item.c_str(), item.size(), width - 20), DEFAULT_MARGIN + 10, y + 8);
+}
+
+size_t selectFromList(const std::vector<std::string> &items, size_t startIndex,
+                      std::function<void(size_t)> onHighlight)
+{
+    // Position in the visible items, which are all items while not filtering
+    size_t selected = std::min(startIndex, items.size() ? items.size() - 1 : 0);
+    size_t offset = 0;
+    std::string filter;
+    std::vector<size_t> matches;
+    PrefixIndex index(items);
+
+    auto count = [&]() { return filter.empty() ? items.size() : matches.size(); };
+    auto itemAt = [&](size_t position) { return filter.empty() ? position : matches[position]; };
+
+    // What is on screen, rows are only redrawn when these change
+    bool fullRedraw = true;
+    size_t drawnOffset = 0;
+    size_t drawnSelected = 0;
+    bool firstRender = true;
+
+    while (true)
+    {
         // Wait for button input
         char input = promptInputHandler();
 
@@ -185,24 +449,42 @@ unsigned int selectFromList(std::vector<std::string> items, unsigned int startIn
         {
         case KEY_ARROW_UP:
         case KEY_ARROW_LEFT:
-            if (selectedIndex > 0)
+        case KEY_CHAR_UP:
+        case KEY_CHAR_LEFT:
+            if (selected > 0)
             {
-                selectedIndex--;
+                selected--;
             }
             firstRender = false;
             break;
 
         case KEY_ARROW_DOWN:
         case KEY_ARROW_RIGHT:
-            if (selectedIndex < items.size() - 1)
+        case KEY_CHAR_DOWN:
+        case KEY_CHAR_RIGHT:
+            if (selected + 1 < count())
             {
-                selectedIndex++;
+                selected++;
             }
             firstRender = false;
             break;
 
         case KEY_OK:
-            return selectedIndex;
+            if (count())
+            {
+                return itemAt(selected);
+            }
+            continue;
+        case KEY_DEL:
+            if (filter.empty())
+            {
+                continue;
+            }
+            utf8PopBack(filter);
+            index.match(filter, matches);
+            selected = 0;
+            fullRedraw = true;
+            break;
         case KEY_NONE:
             // No input, continue
             if (firstRender)
@@ -213,46 +495,83 @@ unsigned int selectFromList(std::vector<std::string> items, unsigned int startIn
             {
                 continue;
             }
+            break;
         default:
+            // anything printable narrows the list to the items starting with it
+            if ((unsigned char)input < ' ' || input == KEY_ESC)
+            {
+                continue;
+            }
+            filter += input;
+            index.match(filter, matches);
+            selected = 0;
+            fullRedraw = true;
             break;
         }
 
-        // Clear screen
-        displayClearMainView();
+        if (onHighlight && count())
+        {
+            onHighlight(itemAt(selected));
+        }
 
-        const int VISIBLE_ROWS = 4;
-        static int offset = 0;
+        unsigned long renderStart = micros();
 
-        if (selectedIndex < offset)
+        const size_t fullRows = filter.empty() ? LIST_ROWS - 1 : LIST_ROWS - 2;
+        if (selected < offset)
         {
-            offset = selectedIndex; // Scroll up
+            offset = selected; // Scroll up
         }
-        else if (selectedIndex >= offset + VISIBLE_ROWS)
+        else if (selected >= offset + fullRows)
         {
-            offset = selectedIndex - (VISIBLE_ROWS - 1); // Scroll down
+            offset = selected - (fullRows - 1); // Scroll down
         }
 
-        displayClearMainView();
-        for (int i = 0; i < VISIBLE_ROWS + 1 && (i + offset) < items.size(); ++i)
+        layout.setTextSize(1.5);
+        if (fullRedraw || offset != drawnOffset)
         {
-            int idx = i + offset;
-            bool isSelected = (idx == selectedIndex);
-
-            drawRect(isSelected, DEFAULT_MARGIN, DEFAULT_MARGIN + (i * 30), M5.Lcd.width() - 15, 25);
-            M5.Lcd.setCursor(DEFAULT_MARGIN + 10, DEFAULT_MARGIN + 8 + (i * 30));
-            M5.Lcd.print(items[idx].substr(0, 23).c_str());
+            displayClearMainView();
+            size_t rows = filter.empty() ? LIST_ROWS : LIST_ROWS - 1;
+            for (size_t i = 0; i < rows && offset + i < count(); ++i)
+            {
+                drawListRow(items[itemAt(offset + i)], i, offset + i == selected);
+            }
+            if (!filter.empty())
+            {
+                // the partly visible last row makes room for the filter
+                int32_t y = M5.Lcd.height() - 15;
+                M5.Lcd.fillRect(0, y - 3, M5.Lcd.width(), 18, RECT_COLOR_DARK);
+                layout.setTextColor(PRIMARY_COLOR);
+                std::string text = "Filter: " + filter + (matches.empty() ? " (none)" : "");
+                layout.draw(text.c_str(), text.size(), DEFAULT_MARGIN, y);
+            }
         }
+        else if (selected != drawnSelected)
+        {
+            // only the rows that gained or lost the selection
+            drawListRow(items[itemAt(drawnSelected)], drawnSelected - offset, false);
+            drawListRow(items[itemAt(selected)], selected - offset, true);
+        }
+        fullRedraw = false;
+        drawnOffset = offset;
+        drawnSelected = selected;
+        metrics.record(TIMING_RENDER_LIST, micros() - renderStart);
 
         delay(100);
     }
-
-    return selectedIndex;
 }
 
 std::string getInput(std::string prompt)
 {
     bool firstRender = true;
-    std::string ret = "";
+    bool drawn = false;
+    LineEditor editor;
+    EditorView view;
+
+    // Box
+    uint16_t boxWidth = M5.Lcd.width() - 40;
+    uint16_t boxHeight = 30;
+    uint16_t boxX = 20;
+    uint16_t boxY = (M5.Lcd.height() - boxHeight) / 2;
 
     while (1)
     {
@@ -262,19 +581,13 @@ std::string getInput(std::string prompt)
 
         switch (input)
         {
-        case KEY_DEL:
-            if (ret.size())
-            {
-                ret.pop_back();
-            }
-            break;
         case KEY_RETURN:
         case KEY_OK:
             if (firstRender)
             {
                 continue;
             }
-            return ret;
+            return editor.text();
         case KEY_NONE:
             // No input, continue
             if (firstRender)
@@ -286,46 +599,43 @@ std::string getInput(std::string prompt)
             {
                 continue;
             }
+        case KEY_NEWLINE:
+            continue; // fields are a single line
         default:
-            ret += input;
+            if (!editor.handle(input))
+            {
+                continue;
+            }
             break;
         }
 
-        // Clear screen
-        displayClearMainView();
+        layout.setTextColor(TEXT_COLOR);
+        layout.setTextSize(1.5);
 
-        std::string sendString = ret;
-
-        if (sendString.length() > 26)
+        if (!drawn)
         {
-            sendString = sendString.substr(sendString.length() - 26);
-        }
+            // Clear screen
+            displayClearMainView();
 
-        // TODO print prompt to tell user what they are entering
+            // TODO print prompt to tell user what they are entering
 
-        // Draw box
-        uint16_t boxWidth = M5.Lcd.width() - 40;
-        uint16_t boxHeight = 30;
-        uint16_t boxX = 20;
-        uint16_t boxY = (M5.Lcd.height() - boxHeight) / 2;
-
-        M5.Lcd.fillRoundRect(boxX, boxY, boxWidth, boxHeight, DEFAULT_ROUND_RECT, RECT_COLOR_DARK);
-        M5.Lcd.drawRoundRect(boxX, boxY, boxWidth, boxHeight, DEFAULT_ROUND_RECT, PRIMARY_COLOR);
+            M5.Lcd.fillRoundRect(boxX, boxY, boxWidth, boxHeight, DEFAULT_ROUND_RECT, RECT_COLOR_DARK);
+            M5.Lcd.drawRoundRect(boxX, boxY, boxWidth, boxHeight, DEFAULT_ROUND_RECT, PRIMARY_COLOR);
+            layout.draw("> ", 2, boxX + 10, boxY + (boxHeight / 2) - 8);
+            M5.Lcd.setCursor(boxX + 10, boxY - 20);
+            M5.Lcd.print(prompt.c_str());
+        }
 
-        // Print typed message
-        M5.Lcd.setTextColor(TEXT_COLOR);
-        M5.Lcd.setTextSize(1.5);
-        M5.Lcd.setCursor(boxX + 10, boxY + (boxHeight / 2) - 8);
-        M5.Lcd.print("> ");
-        M5.Lcd.print(sendString.c_str());
-        M5.Lcd.setCursor(boxX + 10, boxY - 20);
-        M5.Lcd.print(prompt.c_str());
+        // Print typed message, only what changed since the last key
+        int32_t left = boxX + 10 + layout.width("> ", 2);
+        drawEditorLine(editor, view, left, boxX + boxWidth - 10, boxY + (boxHeight / 2) - 8, !drawn);
+        drawn = true;
 
         delay(100);
     }
 }
 
-bool confirm(std::string prompt)
+bool confirm(std::string prompt, std::string yes, std::string no)
 {
     bool choice = true;
     bool firstRender = true;
@@ -339,10 +649,14 @@ bool confirm(std::string prompt)
         {
         case KEY_ARROW_LEFT:
         case KEY_ARROW_UP:
+        case KEY_CHAR_LEFT:
+        case KEY_CHAR_UP:
             choice = true;
             break;
         case KEY_ARROW_RIGHT:
         case KEY_ARROW_DOWN:
+        case KEY_CHAR_RIGHT:
+        case KEY_CHAR_DOWN:
             choice = false;
             break;
         case KEY_OK:
@@ -383,13 +697,14 @@ bool confirm(std::string prompt)
         uint16_t btnHeight = 25;
         uint16_t btnY = M5.Lcd.height() - 45;
 
+        // labels centered, about 9 pixels a character at this size
         drawRect(choice, 40, btnY, btnWidth, btnHeight);
-        M5.Lcd.setCursor(40 + 18, btnY + 8);
-        M5.Lcd.print("YES");
+        M5.Lcd.setCursor(40 + (btnWidth - 9 * (int)yes.length()) / 2, btnY + 8);
+        M5.Lcd.print(yes.c_str());
 
         drawRect(!choice, 140, btnY, btnWidth, btnHeight);
-        M5.Lcd.setCursor(140 + 22, btnY + 8);
-        M5.Lcd.print("NO");
+        M5.Lcd.setCursor(140 + (btnWidth - 9 * (int)no.length()) / 2, btnY + 8);
+        M5.Lcd.print(no.c_str());
 
         delay(100);
     }
@@ -3,6 +3,7 @@
 
 #include <vector>
 #include <string>
+#include <functional>
 #include <M5Cardputer.h> // Assurez-vous que cette bibliothèque est la bonne selon votre matériel (M5Stack, M5Cardputer, etc.)
 
 #define BACKGROUND_COLOR TFT_BLACK
@@ -15,17 +16,32 @@
 #define DEFAULT_MARGIN 5
 #define DEFAULT_ROUND_RECT 5
 
+class GlyphCache;
+class LineEditor;
+
 void displayInit();
+void displaySetGlyphs(GlyphCache *glyphs);
 void displayWelcome();
 void displayStart(bool selected);
-void displayTerminal(std::string terminalSting, size_t scroll = 0);
-void displayPrompt(std::string sendString);
+#define TERMINAL_LINES 12
+#define STATUS_BAR_HEIGHT 10
+#define STATUS_INTERVAL 1000 // ms between status bar updates
+
+size_t displayTerminal(std::string terminalSting, size_t scroll = 0);
+size_t displayLineCount(const std::string &terminalString);
+void displayTerminalNotice(std::string notice);
+// Redraws the status bar fields whose text changed since the last call
+void displayStatusBar(bool full = false);
+void displayPrompt(const LineEditor &editor, bool full = false);
 void displayClearMainView(uint8_t offsetY = 0);
 void displayClearTerminalView();
 void showMessage(std::string message);
-unsigned int selectFromList(std::vector<std::string> items, unsigned int startIndex = 0);
+// Returns the index of the chosen item. Typing filters the list to the items
+// starting with what was typed.
+size_t selectFromList(const std::vector<std::string> &items, size_t startIndex = 0,
+                      std::function<void(size_t)> onHighlight = nullptr);
 std::string getInput(std::string);
-bool confirm(std::string prompt);
+bool confirm(std::string prompt, std::string yes = "YES", std::string no = "NO");
 
 
 // Utility Function (forward declaration if needed)
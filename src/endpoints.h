@@ -0,0 +1,71 @@
+#ifndef ENDPOINTS_H
+#define ENDPOINTS_H
+
+#include "requestbody.h"
+
+#include <ArduinoJson.h>
+
+// Checks the shape of a parsed answer, error objects never get this far
+typedef bool (*ResponseCheck)(JsonVariantConst body);
+
+inline bool anyBody(JsonVariantConst) { return true; }
+inline bool arrayBody(JsonVariantConst body) { return body.is<JsonArrayConst>(); }
+inline bool tokenBody(JsonVariantConst body) { return body["token"].is<const char *>(); }
+
+#define RETRY_BACKOFF 400 // ms before the first retry, doubled for each one after
+
+// One call of the Message Jar API
+struct Endpoint
+{
+    const char *path;    // after the server url
+    BodyFields fields;   // request fields, values are passed in this order
+    bool needsBody;      // without, an empty or unparseable answer is success
+    ResponseCheck check; // a parsed answer that fails it is a transport error
+    uint16_t timeout;    // ms to wait for the answer
+    uint8_t retries;     // after a transport error, only where sending twice is harmless
+};
+
+enum EndpointId
+{
+    ENDPOINT_USERNAME,
+    ENDPOINT_USER_NEW,
+    ENDPOINT_USER_EXISTS,
+    ENDPOINT_USER_GENERATE,
+    ENDPOINT_TOKEN_REVOKE,
+    ENDPOINT_ROOMS_LIST,
+    ENDPOINT_ROOMS_CREATE,
+    ENDPOINT_GET,
+    ENDPOINT_STREAM,
+    ENDPOINT_SEND,
+    ENDPOINT_SEND_BATCH,
+    ENDPOINT_COUNT
+};
+
+constexpr const char *TOKEN_FIELDS[] = {"token"};
+constexpr const char *ROOM_FIELDS[] = {"token", "room"};
+constexpr const char *GET_FIELDS[] = {"token", "room", "latest", "wait"};
+constexpr const char *SEND_FIELDS[] = {"token", "room", "message"};
+constexpr const char *BATCH_FIELDS[] = {"token", "messages"}; // written by send_batch
+constexpr const char *ACCOUNT_FIELDS[] = {"username", "password", "name"};
+
+// Indexed by EndpointId. tools/stub_server.py answers the same list, its
+// --check compares the two. Sends are not retried here, the outbox tries
+// again on its own schedule.
+constexpr Endpoint ENDPOINTS[] = {
+    {"/token/username", bodyFields(TOKEN_FIELDS), false, anyBody, 5000, 2},
+    {"/user/new", bodyFields(ACCOUNT_FIELDS), false, anyBody, 10000, 0},
+    {"/user/exists", bodyFields(ACCOUNT_FIELDS), true, anyBody, 5000, 2},
+    {"/user/generate", bodyFields(ACCOUNT_FIELDS), true, tokenBody, 10000, 0},
+    {"/token/revoke", bodyFields(TOKEN_FIELDS), false, anyBody, 5000, 1},
+    {"/rooms/list", bodyFields(TOKEN_FIELDS), true, arrayBody, 8000, 2},
+    {"/rooms/create", bodyFields(ROOM_FIELDS), false, anyBody, 8000, 0},
+    {"/get", bodyFields(GET_FIELDS), true, arrayBody, 5000, 1}, // a long poll sets its own
+    {"/stream", bodyFields(GET_FIELDS), false, anyBody, 5000, 0}, // events, read by the transport
+    {"/send", bodyFields(SEND_FIELDS), false, anyBody, 8000, 0},
+    {"/send/batch", bodyFields(BATCH_FIELDS), false, anyBody, 15000, 0},
+};
+
+static_assert(sizeof(ENDPOINTS) / sizeof(ENDPOINTS[0]) == ENDPOINT_COUNT,
+              "one ENDPOINTS entry per EndpointId");
+
+#endif // ENDPOINTS_H
@@ -1,53 +1,192 @@
 #include "event.h"
 #include "messagejar.h"
+#include "metrics.h"
+#include "tasks.h"
+#include "telemetry.h"
+#include <WiFi.h>
+#include <memory>
 #include <string>
 #include <thread>
 
-#define TICKS 1000
-
 using std::string;
 
-shared_ptr<vector<Message>> get(string room, std::mutex &userMutex,
-                                MessageJar *user, size_t latest = 0) {
+bool get(const string &room, std::mutex &userMutex, MessageJar *user,
+         size_t latest, vector<Message> &out, Arena &arena,
+         PollBuffers &buffers) {
   std::lock_guard<std::mutex> lock(userMutex);
-  return user->get_messages(room, latest);
+  return user->get_messages(room, latest, out, arena, buffers) == RESPONSE_OK;
 }
 
 void messageTask(void *pvParameters) {
   // Cast the void pointer back to our struct
   MessageTaskParams *params = (MessageTaskParams *)pvParameters;
 
-  size_t latest_message = 0;
+  size_t latest_message = params->latest;
+
+  // per poll temporaries, reused so polling does not churn the heap
+  Arena arena;
+  vector<Message> messages;
+  string buffer;
+  bool indexed = false;
+
+  std::unique_ptr<Transport> transport(
+      makeTransport(*(params->transport), params->user, params->userMutex,
+                    params->pollInterval, params->cancel.get()));
 
-  unsigned long last_executed = millis();
-  unsigned long current_time =
-      TICKS + 1 + last_executed; // get messages right away
+  // leaving the room cancels a long poll, the session tells us it was left
+  // when the poll answered anyway
+  auto current = [params]() {
+    return *(params->running) && *(params->session) == params->sessionId;
+  };
 
-  while (*(params->running)) {
-    if ((current_time - last_executed) > TICKS) {
+  telemetry.publishStart();
+  while (current()) {
+    bool ok = transport->next(params->room, latest_message, messages, arena);
+    if (!current()) {
+      break;
+    }
+    telemetry.publishPoll(ok);
+
+    metrics.add(COUNTER_POLLS);
+    if (ok && messages.empty()) {
+      metrics.add(COUNTER_POLLS_EMPTY);
+    }
 
-      shared_ptr<vector<Message>> messages =
-          get(params->room, *(params->userMutex), params->user, latest_message);
+    if (ok && messages.size()) {
+      // a room entered meanwhile counts its history under the same lock, so
+      // these are stored before that or not at all
+      std::lock_guard<std::mutex> session(*(params->sessionMutex));
+      if (!current()) {
+        break;
+      }
+      latest_message += messages.size();
+      metrics.add(COUNTER_MESSAGES, messages.size());
+      params->history->append(params->room, messages, latest_message);
+      buffer.clear();
+      // buffer += std::to_string(messages->size());
+      for (const auto &msg : messages) {
+        msg.append_to(buffer);
+      }
+
+      std::lock_guard<std::mutex> lock(*(params->receiveMutex));
+
+      *(params->receiveString) = buffer;
+      *(params->sendDataFlag) = true;
+    }
 
-      if (messages && messages->size()) {
-        latest_message += messages->size();
-        string buffer = "";
-        // buffer += std::to_string(messages->size());
-        for (const auto &msg : *messages) {
-          buffer += msg.as_string();
+    messages.clear();
+    arena.reset();
+
+    // a page or so of the room's log the index has not seen per poll, so
+    // the first search in the room does not have to do it all at once
+    if (!indexed) {
+      indexed = params->search->catchUp(params->room, SEARCH_CATCH_UP_STEP);
+    }
+
+    telemetry.publishQueue(params->outbox->pending());
+    telemetry.publishLink();
+
+    if (transport->unsupported()) {
+      // remember for the next room, polling is always there to fall back on
+      TransportMode lower = (TransportMode)(transport->mode() - 1);
+      *(params->transport) = lower;
+      transport.reset(makeTransport(lower, params->user, params->userMutex,
+                                    params->pollInterval,
+                                    params->cancel.get()));
+    }
+
+    metrics.service();
+    params->input->service();
+  }
+
+  delete params;
+  finishTask();
+}
+
+void prefetchTask(void *pvParameters) {
+  PrefetchTaskParams *params = (PrefetchTaskParams *)pvParameters;
+
+  Arena arena;
+  vector<Message> messages;
+  PollBuffers buffers;
+
+  auto current = [params]() {
+    return *(params->session) == params->sessionId;
+  };
+
+  while (current()) {
+    // pick the first wanted room that is not cached yet
+    string room;
+    {
+      std::lock_guard<std::mutex> lock(*(params->wantedMutex));
+      for (const auto &candidate : *(params->wanted)) {
+        if (!params->cache->contains(candidate)) {
+          room = candidate;
+          break;
         }
+      }
+    }
+
+    metrics.service();
+    params->input->service();
+
+    telemetry.publishQueue(params->outbox->pending());
+    telemetry.publishLink();
+
+    if (room.empty()) {
+      delay(50);
+      continue;
+    }
 
-        std::lock_guard<std::mutex> lock(*(params->receiveMutex));
+    // only what arrived since the last visit, the rest is on the SD card
+    size_t latest = params->history->count(room);
+    bool ok = get(room, *(params->userMutex), params->user, latest, messages,
+                  arena, buffers);
 
-        *(params->receiveString) = buffer;
-        *(params->sendDataFlag) = true;
+    if (ok) {
+      // the room may be open by now with its history counted, what was
+      // fetched after that is left to its message task
+      std::lock_guard<std::mutex> session(*(params->sessionMutex));
+      if (!current()) {
+        break;
       }
+      latest += messages.size();
+      RoomSnapshot snap;
+      if (params->history->append(room, messages, latest)) {
+        size_t start;
+        snap.text = params->history->before(room, params->history->size(room),
+                                            HISTORY_PAGE, start);
+        snap.latest = latest;
+      } else {
+        snap = RoomCache::snapshot(messages, latest);
+      }
+      params->cache->store(room, std::move(snap));
+    }
+
+    messages.clear();
+    arena.reset();
 
-      last_executed = millis();
+    if (!ok) {
+      delay(TICKS); // don't hammer the server for a failing room
     }
-    current_time = millis();
   }
 
   delete params;
-  vTaskDelete(NULL);
-}
\ No newline at end of file
+  finishTask();
+}
+
+void outboxTask(void *pvParameters) {
+  OutboxTaskParams *params = (OutboxTaskParams *)pvParameters;
+
+  while (true) {
+    if (!params->outbox->waitForFlush(OUTBOX_RETRY)) {
+      continue;
+    }
+    if (WiFi.status() != WL_CONNECTED) {
+      // kept for when the link is back, the journal has it meanwhile
+      delay(OUTBOX_RETRY);
+      continue;
+    }
+    params->outbox->flush(params->user, *(params->userMutex));
+  }
+}
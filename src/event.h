@@ -3,9 +3,16 @@
 
 #include <string>
 #include <atomic>
+#include <memory>
 #include <mutex>
 #include "input.h"
 #include "messagejar.h"
+#include "history.h"
+#include "inputstore.h"
+#include "outbox.h"
+#include "roomcache.h"
+#include "search.h"
+#include "transport.h"
 
 struct MessageTaskParams
 {
@@ -15,11 +22,48 @@ struct MessageTaskParams
     std::mutex *receiveMutex;
     std::mutex *userMutex;
     MessageJar *user;
+    History *history;
     string room;
+    size_t latest;
+    std::atomic<TransportMode> *transport; // lowered when the server lacks a mode
+    uint32_t pollInterval;                 // least ms between polls, from the profile
+    const std::atomic<uint32_t> *session;  // bumped every time a room is entered
+    uint32_t sessionId;
+    std::mutex *sessionMutex; // held to store what was fetched, and to change rooms
+    Outbox *outbox;
+    InputStore *input;
+    SearchIndex *search;                  // kept caught up with the room's log
+    std::shared_ptr<Cancellation> cancel; // cancelled when the room is left
 };
 
-shared_ptr<vector<Message>> get(string room, std::mutex &userMutex, MessageJar *user);
+struct PrefetchTaskParams
+{
+    const std::atomic<uint32_t> *session; // bumped when the room list is left
+    uint32_t sessionId;
+    std::mutex *sessionMutex; // held to store what was fetched
+    std::mutex *wantedMutex;
+    vector<string> *wanted;
+    std::mutex *userMutex;
+    MessageJar *user;
+    History *history;
+    RoomCache *cache;
+    Outbox *outbox;
+    InputStore *input;
+};
+
+// Sends the queue of one profile's outbox, for as long as the device runs
+struct OutboxTaskParams
+{
+    Outbox *outbox;
+    std::mutex *userMutex;
+    MessageJar *user;
+};
+
+bool get(const string &room, std::mutex &userMutex, MessageJar *user, size_t latest,
+         vector<Message> &out, Arena &arena, PollBuffers &buffers);
 
 void messageTask(void *pvParameters);
+void prefetchTask(void *pvParameters);
+void outboxTask(void *pvParameters);
 
 #endif
\ No newline at end of file
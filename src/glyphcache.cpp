@@ -0,0 +1,106 @@
+#include "glyphcache.h"
+#include "metrics.h"
+
+#include <iterator>
+#include <string.h>
+
+#define GLYPH_HEADER_SIZE 12
+#define GLYPH_INDEX_ENTRY 8
+
+static uint32_t read_u32(const uint8_t *p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+GlyphCache::GlyphCache(SdService &sd, const char *path) : sd(sd), path(path) {}
+
+bool GlyphCache::begin() {
+  std::string header = sd.readFileRange(path, 0, GLYPH_HEADER_SIZE);
+  if (header.size() != GLYPH_HEADER_SIZE || header.compare(0, 4, "MJF1")) {
+    return false;
+  }
+
+  const uint8_t *p = (const uint8_t *)header.data();
+  glyphHeight = p[4];
+  count = read_u32(p + 8);
+  entries.clear();
+  file.close();
+  file = sd.openFile(path, FILE_READ);
+  return count > 0;
+}
+
+const Glyph &GlyphCache::get(uint32_t codepoint) {
+  for (auto it = entries.begin(); it != entries.end(); ++it) {
+    if (it->codepoint == codepoint) {
+      entries.splice(entries.begin(), entries, it);
+      return entries.front();
+    }
+  }
+
+  metrics.add(COUNTER_GLYPH_MISSES);
+  if (entries.size() >= GLYPH_CACHE_ENTRIES) {
+    // reuse the oldest entry, its bitmap buffer included
+    entries.splice(entries.begin(), entries, std::prev(entries.end()));
+  } else {
+    entries.emplace_front();
+  }
+
+  Glyph &glyph = entries.front();
+  glyph.codepoint = codepoint;
+  if (!load(codepoint, glyph)) {
+    // remembered as missing so the card is not searched again
+    glyph.width = 0;
+    glyph.bits.clear();
+  }
+  return glyph;
+}
+
+bool GlyphCache::load(uint32_t codepoint, Glyph &glyph) {
+  if (!count) {
+    return false;
+  }
+
+  if (!file) {
+    // the card was busy or reinserted since
+    file = sd.openFile(path, FILE_READ);
+    if (!file) {
+      return false;
+    }
+  }
+
+  // binary search over the fixed size index entries
+  uint8_t entry[GLYPH_INDEX_ENTRY];
+  uint32_t low = 0;
+  uint32_t high = count;
+  uint32_t offset = 0;
+  bool failed = false;
+  while (low < high) {
+    uint32_t mid = (low + high) / 2;
+    file.seek(GLYPH_HEADER_SIZE + mid * GLYPH_INDEX_ENTRY);
+    if (file.read(entry, sizeof(entry)) != sizeof(entry)) {
+      failed = true;
+      break;
+    }
+
+    uint32_t found = read_u32(entry);
+    if (found == codepoint) {
+      offset = read_u32(entry + 4);
+      break;
+    }
+    if (found < codepoint) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+
+  bool loaded = false;
+  if (offset && file.seek(offset) && file.read(&glyph.width, 1) == 1) {
+    size_t size = (size_t)((glyph.width + 7) / 8) * glyphHeight;
+    glyph.bits.resize(size);
+    loaded = file.read(glyph.bits.data(), size) == size;
+  }
+  if (failed || (offset && !loaded)) {
+    file.close();
+  }
+  return loaded;
+}
@@ -0,0 +1,53 @@
+#ifndef GLYPHCACHE_H
+#define GLYPHCACHE_H
+
+#include "SdService.h"
+
+#include <list>
+#include <stdint.h>
+#include <vector>
+
+#define GLYPH_FONT_PATH "/mjfont.bin"
+#define GLYPH_CACHE_ENTRIES 96 // decoded glyphs kept in RAM
+
+// A 1 bit glyph, rows padded to whole bytes, most significant bit first
+struct Glyph
+{
+    uint32_t codepoint = 0;
+    uint8_t width = 0; // 0 when the font lacks the codepoint
+    std::vector<uint8_t> bits;
+};
+
+// LRU of non-ASCII glyphs read from a packed bitmap font on the SD card
+// (see tools/pack_font.py). ASCII is left to the display's built-in font.
+//
+// File layout, little endian: "MJF1", height (u8), 3 reserved bytes, glyph
+// count (u32), then count index entries of codepoint (u32) and offset (u32)
+// sorted by codepoint. Each glyph at its offset is a width byte followed by
+// height rows of (width + 7) / 8 bytes.
+class GlyphCache
+{
+public:
+    GlyphCache(SdService &sd, const char *path = GLYPH_FONT_PATH);
+
+    // Opens the font and keeps it open for the misses, false when there is
+    // none
+    bool begin();
+    bool available() const { return count > 0; }
+    uint8_t height() const { return glyphHeight; }
+
+    // Loads the glyph on a miss, its width is 0 when the font lacks it
+    const Glyph &get(uint32_t codepoint);
+
+private:
+    bool load(uint32_t codepoint, Glyph &glyph);
+
+    SdService &sd;
+    const char *path;
+    uint8_t glyphHeight = 0;
+    uint32_t count = 0;
+    File file; // reopened on the next miss after a failed read
+    std::list<Glyph> entries; // front is most recently used
+};
+
+#endif // GLYPHCACHE_H
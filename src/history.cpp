@@ -0,0 +1,114 @@
+#include "history.h"
+#include "search.h"
+
+#include <ArduinoJson.h>
+#include <cstdio>
+
+History::History(SdService &sd, const string &dir) : sd(sd), dir(dir) {}
+
+bool History::available() {
+  return sd.getSdState() && sd.ensureDirectory(dir);
+}
+
+size_t History::count(const string &room) {
+  string data = sd.readFile(path(room, ".cnt"));
+  return data.empty() ? 0 : strtoul(data.c_str(), nullptr, 10);
+}
+
+size_t History::size(const string &room) {
+  return sd.fileSize(path(room, ".log"));
+}
+
+bool History::append(const string &room, const vector<Message> &messages,
+                     size_t latest) {
+  if (!available()) {
+    return false;
+  }
+
+  string buffer;
+  for (const auto &msg : messages) {
+    msg.append_to(buffer);
+  }
+
+  // log first: a crash in between refetches messages instead of losing them
+  size_t offset = size(room);
+  if (!buffer.empty() && !sd.appendToFile(path(room, ".log"), buffer)) {
+    return false;
+  }
+  if (index && !buffer.empty()) {
+    index->add(room, buffer, offset);
+  }
+  return sd.writeFile(path(room, ".cnt"), std::to_string(latest));
+}
+
+string History::before(const string &room, size_t end, size_t maxBytes,
+                       size_t &start) {
+  start = end > maxBytes ? end - maxBytes : 0;
+  string text = sd.readFileRange(path(room, ".log"), start, end - start);
+
+  if (start > 0) {
+    size_t cut = text.find('\n');
+    if (cut != string::npos && cut + 1 < text.size()) {
+      text.erase(0, cut + 1);
+      start += cut + 1;
+    }
+  }
+  return text;
+}
+
+string History::after(const string &room, size_t start, size_t maxBytes) {
+  string text = sd.readFileRange(path(room, ".log"), start, maxBytes);
+
+  if (text.size() == maxBytes) {
+    size_t cut = text.rfind('\n');
+    if (cut != string::npos) {
+      text.erase(cut + 1);
+    }
+  }
+  return text;
+}
+
+bool History::storeRooms(const vector<string> &rooms) {
+  if (!available()) {
+    return false;
+  }
+
+  JsonDocument doc;
+  JsonArray arr = doc.to<JsonArray>();
+  for (const auto &room : rooms) {
+    arr.add(room);
+  }
+  string output;
+  serializeJson(doc, output);
+  return sd.writeFile(dir + "/rooms.json", output);
+}
+
+shared_ptr<vector<string>> History::rooms() {
+  JsonDocument doc;
+  if (deserializeJson(doc, sd.readFile(dir + "/rooms.json")) ||
+      !doc.is<JsonArray>()) {
+    return nullptr;
+  }
+
+  auto rooms = std::make_shared<vector<string>>();
+  for (JsonVariant v : doc.as<JsonArray>()) {
+    rooms->push_back(v.as<string>());
+  }
+  return rooms;
+}
+
+string History::path(const string &room, const char *ext) {
+  // room names can hold anything, keep the readable part and add a hash
+  uint32_t hash = 2166136261u;
+  string name;
+  for (unsigned char c : room) {
+    hash = (hash ^ c) * 16777619u;
+    if (name.size() < 24 && (isalnum(c) || c == '-' || c == '_')) {
+      name += c;
+    }
+  }
+
+  char suffix[10];
+  snprintf(suffix, sizeof(suffix), "-%08x", (unsigned int)hash);
+  return dir + "/" + name + suffix + ext;
+}
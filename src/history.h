@@ -0,0 +1,51 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include "SdService.h"
+#include "messagejar.h"
+
+#include <memory>
+#include <string>
+
+using std::string;
+
+class SearchIndex;
+
+#define HISTORY_DIR "/mjcache"
+#define HISTORY_PAGE 2048   // bytes loaded per page when scrolling
+#define HISTORY_WINDOW 8192 // bytes of history the terminal keeps in memory
+#define HISTORY_MARGIN 4    // lines from the window edge that trigger a page load
+
+// Append only log of the formatted messages of every room, kept on the SD
+// card so a room only has to download what arrived since the last visit.
+class History
+{
+public:
+    History(SdService &sd, const string &dir = HISTORY_DIR);
+
+    bool available();
+    size_t count(const string &room);
+    size_t size(const string &room);
+    bool append(const string &room, const vector<Message> &messages, size_t latest);
+
+    // Text of whole lines ending at `end`, at most `maxBytes` long.
+    // `start` is set to the offset of the first returned byte.
+    string before(const string &room, size_t end, size_t maxBytes, size_t &start);
+    // Text of whole lines starting at `start`, at most `maxBytes` long.
+    string after(const string &room, size_t start, size_t maxBytes);
+
+    // Last room list fetched, for browsing while offline
+    bool storeRooms(const vector<string> &rooms);
+    shared_ptr<vector<string>> rooms();
+
+    // Appended text is handed to the index as well
+    void setIndex(SearchIndex *index) { this->index = index; }
+    string path(const string &room, const char *ext);
+
+private:
+    SdService &sd;
+    string dir;
+    SearchIndex *index = nullptr;
+};
+
+#endif // HISTORY_H
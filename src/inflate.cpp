@@ -0,0 +1,146 @@
+#include "inflate.h"
+
+#include <stdlib.h>
+
+#define GZIP_FHCRC 0x02
+#define GZIP_FEXTRA 0x04
+#define GZIP_FNAME 0x08
+#define GZIP_FCOMMENT 0x10
+
+static std::mutex workspaceMutex;
+static tinfl_decompressor *workspaceDecompressor = nullptr;
+static uint8_t *workspaceWindow = nullptr;
+
+InflateLease::InflateLease() {
+  if (!workspaceMutex.try_lock()) {
+    return;
+  }
+  if (!workspaceWindow) {
+    // one try per lease, a heap too fragmented now may not be later
+    workspaceDecompressor =
+        (tinfl_decompressor *)malloc(sizeof(tinfl_decompressor));
+    workspaceWindow = (uint8_t *)malloc(TINFL_LZ_DICT_SIZE);
+    if (!workspaceDecompressor || !workspaceWindow) {
+      free(workspaceDecompressor);
+      free(workspaceWindow);
+      workspaceDecompressor = nullptr;
+      workspaceWindow = nullptr;
+      workspaceMutex.unlock();
+      return;
+    }
+  }
+  holding = true;
+}
+
+InflateLease::~InflateLease() {
+  if (holding) {
+    workspaceMutex.unlock();
+  }
+}
+
+Inflater::Inflater(const InflateLease &lease, Print &out, bool gzip)
+    : out(out), decompressor(workspaceDecompressor), window(workspaceWindow),
+      flags(gzip ? 0 : TINFL_FLAG_PARSE_ZLIB_HEADER), inHeader(gzip) {
+  if (!lease.held()) {
+    failed = true;
+    return;
+  }
+  tinfl_init(decompressor);
+}
+
+size_t Inflater::write(const uint8_t *buffer, size_t size) {
+  if (failed) {
+    return 0;
+  }
+  compressed += size;
+
+  size_t consumed = 0;
+  if (inHeader) {
+    consumed = skipGzipHeader(buffer, size);
+    if (failed) {
+      return 0;
+    }
+  }
+
+  // the gzip trailer (crc and size) after the deflate stream is ignored.
+  // tinfl can take in all of the input while decoded output still waits for
+  // room in the window, that is drained too: the last write of a body gets
+  // no later call to do it.
+  tinfl_status status = TINFL_STATUS_NEEDS_MORE_INPUT;
+  while (!done &&
+         (consumed < size || status == TINFL_STATUS_HAS_MORE_OUTPUT)) {
+    size_t inSize = size - consumed;
+    size_t outSize = TINFL_LZ_DICT_SIZE - windowPos;
+    status = tinfl_decompress(decompressor, buffer + consumed, &inSize, window,
+                              window + windowPos, &outSize,
+                              flags | TINFL_FLAG_HAS_MORE_INPUT);
+    consumed += inSize;
+
+    if (outSize) {
+      out.write(window + windowPos, outSize);
+      windowPos = (windowPos + outSize) & (TINFL_LZ_DICT_SIZE - 1);
+    }
+
+    if (status < TINFL_STATUS_DONE) {
+      failed = true;
+      return 0;
+    }
+    done = status == TINFL_STATUS_DONE;
+  }
+
+  return size;
+}
+
+size_t Inflater::skipGzipHeader(const uint8_t *buffer, size_t size) {
+  size_t i = 0;
+
+  while (inHeader && i < size) {
+    if (headerPos < sizeof(header)) {
+      header[headerPos++] = buffer[i++];
+      if (headerPos == sizeof(header)) {
+        if (header[0] != 0x1f || header[1] != 0x8b || header[2] != 8) {
+          failed = true;
+          return i;
+        }
+        headerFlags = header[3];
+        extraLeft = 0;
+      }
+      continue;
+    }
+
+    if (headerFlags & GZIP_FEXTRA) {
+      // two length bytes, then that many bytes of extra field
+      if (headerPos < sizeof(header) + 2) {
+        extraLeft |= (size_t)buffer[i++] << (8 * (headerPos++ - sizeof(header)));
+        continue;
+      }
+      if (extraLeft) {
+        size_t skip = std::min(extraLeft, size - i);
+        extraLeft -= skip;
+        i += skip;
+        continue;
+      }
+      headerFlags &= ~GZIP_FEXTRA;
+    } else if (headerFlags & GZIP_FNAME) {
+      if (buffer[i++] == 0) {
+        headerFlags &= ~GZIP_FNAME;
+      }
+    } else if (headerFlags & GZIP_FCOMMENT) {
+      if (buffer[i++] == 0) {
+        headerFlags &= ~GZIP_FCOMMENT;
+      }
+    } else if (headerFlags & GZIP_FHCRC) {
+      if (++extraLeft == 2) {
+        headerFlags &= ~GZIP_FHCRC;
+      }
+      ++i;
+    } else {
+      inHeader = false;
+    }
+  }
+
+  if (inHeader && headerPos == sizeof(header) && !(headerFlags & 0x1e)) {
+    inHeader = false;
+  }
+  return i;
+}
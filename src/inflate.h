@@ -0,0 +1,71 @@
+#ifndef INFLATE_H
+#define INFLATE_H
+
+#include <Arduino.h>
+#include "rom/miniz.h"
+
+#include <mutex>
+
+// The decoder state and TINFL_LZ_DICT_SIZE window, allocated the first time
+// a response may be compressed and kept from then on, so compressed answers
+// do not churn the heap. One response holds them at a time: a request that
+// cannot get them, busy or never allocated for lack of memory, asks for an
+// uncompressed answer instead.
+class InflateLease
+{
+public:
+    InflateLease();
+    ~InflateLease();
+    InflateLease(const InflateLease &) = delete;
+    InflateLease &operator=(const InflateLease &) = delete;
+
+    bool held() const { return holding; }
+
+private:
+    bool holding = false;
+};
+
+// Stream that decompresses a gzip or zlib ("deflate") body written into it
+// and writes the result to `out`. Uses the tinfl decoder in ROM with the
+// buffers of an InflateLease, which must be held, so memory is bounded
+// whatever the body size.
+class Inflater : public Stream
+{
+public:
+    Inflater(const InflateLease &lease, Print &out, bool gzip);
+    Inflater(const Inflater &) = delete;
+    Inflater &operator=(const Inflater &) = delete;
+
+    bool ok() const { return !failed; }
+    bool finished() const { return done; }
+    size_t compressedBytes() const { return compressed; }
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t *buffer, size_t size) override;
+
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+
+private:
+    size_t skipGzipHeader(const uint8_t *buffer, size_t size);
+
+    Print &out;
+    tinfl_decompressor *decompressor;
+    uint8_t *window;
+    size_t windowPos = 0;
+    uint32_t flags;
+
+    // gzip header parsing, see RFC 1952
+    bool inHeader;
+    uint8_t header[10];
+    size_t headerPos = 0;
+    uint8_t headerFlags = 0;
+    size_t extraLeft = 0;
+
+    bool failed = false;
+    bool done = false;
+    size_t compressed = 0;
+};
+
+#endif // INFLATE_H
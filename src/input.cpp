@@ -1,4 +1,5 @@
 #include "input.h"
+#include "power.h"
 
 char configInputHandler() {
     // Update keyboard state
@@ -12,16 +13,16 @@ char configInputHandler() {
             if (status.enter) {
                 return KEY_OK;
             }
-            if(M5Cardputer.Keyboard.isKeyPressed(KEY_ARROW_LEFT)) {
+            if(M5Cardputer.Keyboard.isKeyPressed(KEY_CHAR_LEFT)) {
                 return KEY_ARROW_LEFT;
             }
-            if(M5Cardputer.Keyboard.isKeyPressed(KEY_ARROW_RIGHT)) { 
+            if(M5Cardputer.Keyboard.isKeyPressed(KEY_CHAR_RIGHT)) { 
                 return KEY_ARROW_RIGHT;
             }
-            if(M5Cardputer.Keyboard.isKeyPressed(KEY_ARROW_UP)) {
+            if(M5Cardputer.Keyboard.isKeyPressed(KEY_CHAR_UP)) {
                 return KEY_ARROW_UP;
             }
-            if(M5Cardputer.Keyboard.isKeyPressed(KEY_ARROW_DOWN)) {
+            if(M5Cardputer.Keyboard.isKeyPressed(KEY_CHAR_DOWN)) {
                 return KEY_ARROW_DOWN;
             }
         }
@@ -33,9 +34,11 @@ char configInputHandler() {
 char promptInputHandler() {
     // Update keyboard state
     M5Cardputer.update();
+    power.service();
 
     // Bouton G0
     if (M5Cardputer.BtnA.isPressed()) {
+        power.activity();
         delay(100); // debounce
         return KEY_RETURN;
     }
@@ -43,16 +46,32 @@ char promptInputHandler() {
     if (M5Cardputer.Keyboard.isChange()) {
 
         if (M5Cardputer.Keyboard.isPressed()) {
+            power.activity();
             Keyboard_Class::KeysState status = M5Cardputer.Keyboard.keysState();
 
             if (status.enter) {
-                return KEY_OK;
+                return status.shift ? KEY_NEWLINE : KEY_OK;
             }
             else if (status.del) { 
-                return KEY_DEL;
+                return status.fn ? KEY_DEL_FORWARD : KEY_DEL;
+            }
+            else if (status.tab) {
+                return KEY_TAB;
             }
 
             for (auto c : status.word) {
+                if (status.fn) {
+                    switch (c) {
+                    case KEY_CHAR_UP:
+                        return status.ctrl ? KEY_HISTORY_UP : KEY_ARROW_UP;
+                    case KEY_CHAR_DOWN:
+                        return status.ctrl ? KEY_HISTORY_DOWN : KEY_ARROW_DOWN;
+                    case KEY_CHAR_LEFT:
+                        return status.ctrl ? KEY_WORD_LEFT : KEY_ARROW_LEFT;
+                    case KEY_CHAR_RIGHT:
+                        return status.ctrl ? KEY_WORD_RIGHT : KEY_ARROW_RIGHT;
+                    }
+                }
                 return c; // retourner le premier char saisi
             }
         }
@@ -7,11 +7,25 @@
 #define KEY_DEL '\b'
 #define KEY_NONE '\0'
 #define KEY_RETURN '\r'
-#define KEY_ARROW_UP ';'
-#define KEY_ARROW_DOWN '.'
-#define KEY_ARROW_LEFT ','
-#define KEY_ARROW_RIGHT '/'
 #define KEY_ESC '`'
+#define KEY_TAB '\t'
+
+// Arrows share their keys with ; . , / and need fn held in text fields,
+// the plain keys still move through lists
+#define KEY_CHAR_UP ';'
+#define KEY_CHAR_DOWN '.'
+#define KEY_CHAR_LEFT ','
+#define KEY_CHAR_RIGHT '/'
+#define KEY_ARROW_UP '\x11'
+#define KEY_ARROW_DOWN '\x12'
+#define KEY_ARROW_LEFT '\x13'
+#define KEY_ARROW_RIGHT '\x14'
+#define KEY_WORD_LEFT '\x15'  // ctrl + left
+#define KEY_WORD_RIGHT '\x16' // ctrl + right
+#define KEY_HISTORY_UP '\x17'   // ctrl + up
+#define KEY_HISTORY_DOWN '\x18' // ctrl + down
+#define KEY_DEL_FORWARD '\x7f' // fn + del
+#define KEY_NEWLINE '\x0b'     // shift + enter
 
 char configInputHandler();
 char promptInputHandler();
@@ -0,0 +1,96 @@
+#include "inputstore.h"
+#include "sdwriter.h"
+
+#include <ArduinoJson.h>
+
+InputStore::InputStore(SdService &sd, const string &dir)
+    : sd(sd), dir(dir) {}
+
+void InputStore::load() {
+  sd.ensureDirectory(dir);
+  JsonDocument doc;
+  if (deserializeJson(doc, sd.readFile(dir + INPUT_FILE))) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex);
+  drafts.clear();
+  sent.clear();
+  for (auto pair : doc["drafts"].as<JsonObjectConst>()) {
+    drafts[pair.key().c_str()] = pair.value().as<string>();
+  }
+  for (JsonVariantConst v : doc["sent"].as<JsonArrayConst>()) {
+    if (sent.size() < INPUT_HISTORY) {
+      sent.push_back(v.as<string>());
+    }
+  }
+  dirty = false;
+}
+
+void InputStore::service() {
+  string data;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!dirty || millis() - lastSave < INPUT_SAVE_INTERVAL) {
+      return;
+    }
+
+    JsonDocument doc;
+    JsonObject out = doc["drafts"].to<JsonObject>();
+    for (const auto &item : drafts) {
+      out[item.first] = item.second;
+    }
+    JsonArray ring = doc["sent"].to<JsonArray>();
+    for (const auto &message : sent) {
+      ring.add(message);
+    }
+    serializeJson(doc, data);
+    dirty = false;
+    lastSave = millis();
+  }
+
+  // everything since the last save goes out in this one write
+  sdWriter.post(dir + INPUT_FILE, data, false);
+}
+
+string InputStore::draft(const string &room) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = drafts.find(room);
+  return it == drafts.end() ? "" : it->second;
+}
+
+void InputStore::setDraft(const string &room, const string &text) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = drafts.find(room);
+  if (text.empty()) {
+    if (it != drafts.end()) {
+      drafts.erase(it);
+      dirty = true;
+    }
+  } else if (it == drafts.end() || it->second != text) {
+    drafts[room] = text;
+    dirty = true;
+  }
+}
+
+void InputStore::remember(const string &message) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (message.empty() || (!sent.empty() && sent.front() == message)) {
+    return;
+  }
+  sent.push_front(message);
+  if (sent.size() > INPUT_HISTORY) {
+    sent.pop_back();
+  }
+  dirty = true;
+}
+
+size_t InputStore::recallSize() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return sent.size();
+}
+
+string InputStore::recall(size_t index) {
+  std::lock_guard<std::mutex> lock(mutex);
+  return index < sent.size() ? sent[index] : "";
+}
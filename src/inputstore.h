@@ -0,0 +1,48 @@
+#ifndef INPUTSTORE_H
+#define INPUTSTORE_H
+
+#include "SdService.h"
+#include "history.h"
+
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+
+using std::string;
+
+#define INPUT_FILE "/input.json" // in the history directory
+#define INPUT_HISTORY 20          // sent messages kept for recall
+#define INPUT_SAVE_INTERVAL 5000  // ms between writes while things keep changing
+
+// Unsent drafts per room and a ring of recently sent messages. Changes only
+// touch memory, service() hands them to the SD writer task in one go so
+// typing never waits on the card.
+class InputStore
+{
+public:
+    InputStore(SdService &sd, const string &dir = HISTORY_DIR);
+
+    void load();
+    // Writes pending changes at most every INPUT_SAVE_INTERVAL ms
+    void service();
+
+    string draft(const string &room);
+    void setDraft(const string &room, const string &text);
+
+    void remember(const string &message);
+    size_t recallSize();
+    // 0 is the most recent message
+    string recall(size_t index);
+
+private:
+    SdService &sd;
+    string dir;
+    std::mutex mutex;
+    std::map<string, string> drafts;
+    std::deque<string> sent; // front is newest
+    bool dirty = false;
+    unsigned long lastSave = 0;
+};
+
+#endif // INPUTSTORE_H
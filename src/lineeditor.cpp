@@ -0,0 +1,163 @@
+#include "lineeditor.h"
+#include "input.h"
+
+#include <algorithm>
+#include <string.h>
+
+static bool is_continuation(char c) { return (c & 0xc0) == 0x80; }
+
+bool LineEditor::handle(char key) {
+  switch (key) {
+  case KEY_ARROW_LEFT:
+    left();
+    return true;
+  case KEY_ARROW_RIGHT:
+    right();
+    return true;
+  case KEY_WORD_LEFT:
+    wordLeft();
+    return true;
+  case KEY_WORD_RIGHT:
+    wordRight();
+    return true;
+  case KEY_DEL:
+    erase();
+    return true;
+  case KEY_DEL_FORWARD:
+    eraseForward();
+    return true;
+  case KEY_NEWLINE:
+    insert('\n');
+    return true;
+  default:
+    if ((unsigned char)key >= ' ') {
+      insert(key);
+      return true;
+    }
+    return false;
+  }
+}
+
+void LineEditor::reserve(size_t bytes) {
+  if (gapEnd - gapStart >= bytes) {
+    return;
+  }
+
+  // grow the gap in place, the text after it moves to the new end
+  size_t grow = bytes + EDITOR_GAP;
+  size_t tail = buffer.size() - gapEnd;
+  buffer.resize(buffer.size() + grow);
+  memmove(buffer.data() + gapEnd + grow, buffer.data() + gapEnd, tail);
+  gapEnd += grow;
+}
+
+void LineEditor::moveTo(size_t position) {
+  while (gapStart > position) {
+    buffer[--gapEnd] = buffer[--gapStart];
+  }
+  while (gapStart < position) {
+    buffer[gapStart++] = buffer[gapEnd++];
+  }
+  ++changes;
+}
+
+void LineEditor::insert(char c) {
+  reserve(1);
+  buffer[gapStart++] = c;
+  ++changes;
+}
+
+void LineEditor::insert(const string &text) {
+  reserve(text.size());
+  memcpy(buffer.data() + gapStart, text.data(), text.size());
+  gapStart += text.size();
+  ++changes;
+}
+
+void LineEditor::erase() {
+  if (gapStart == 0) {
+    return;
+  }
+  do {
+    --gapStart;
+  } while (gapStart > 0 && is_continuation(buffer[gapStart]));
+  ++changes;
+}
+
+void LineEditor::eraseForward() {
+  if (gapEnd == buffer.size()) {
+    return;
+  }
+  do {
+    ++gapEnd;
+  } while (gapEnd < buffer.size() && is_continuation(buffer[gapEnd]));
+  ++changes;
+}
+
+void LineEditor::left() {
+  size_t position = gapStart;
+  while (position > 0 && is_continuation(at(--position))) {
+  }
+  moveTo(position);
+}
+
+void LineEditor::right() {
+  size_t position = gapStart;
+  size_t end = size();
+  if (position < end) {
+    ++position;
+  }
+  while (position < end && is_continuation(at(position))) {
+    ++position;
+  }
+  moveTo(position);
+}
+
+void LineEditor::wordLeft() {
+  size_t position = gapStart;
+  while (position > 0 && isspace((unsigned char)at(position - 1))) {
+    --position;
+  }
+  while (position > 0 && !isspace((unsigned char)at(position - 1))) {
+    --position;
+  }
+  moveTo(position);
+}
+
+void LineEditor::wordRight() {
+  size_t position = gapStart;
+  size_t end = size();
+  while (position < end && !isspace((unsigned char)at(position))) {
+    ++position;
+  }
+  while (position < end && isspace((unsigned char)at(position))) {
+    ++position;
+  }
+  moveTo(position);
+}
+
+void LineEditor::clear() {
+  gapStart = 0;
+  gapEnd = buffer.size();
+  ++changes;
+}
+
+void LineEditor::set(const string &text) {
+  clear();
+  insert(text);
+}
+
+string LineEditor::text() const { return slice(0, size()); }
+
+string LineEditor::slice(size_t from, size_t to) const {
+  string out;
+  out.reserve(to - from);
+  if (from < gapStart) {
+    out.append(buffer.data() + from, std::min(to, gapStart) - from);
+  }
+  if (to > gapStart) {
+    size_t start = std::max(from, gapStart) + gapEnd - gapStart;
+    out.append(buffer.data() + start, to + gapEnd - gapStart - start);
+  }
+  return out;
+}
@@ -0,0 +1,55 @@
+#ifndef LINEEDITOR_H
+#define LINEEDITOR_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+#define EDITOR_GAP 64 // bytes the gap grows by
+
+// Text with a cursor, stored as a gap buffer so typing and deleting at the
+// cursor only touch the bytes around it. Cursor moves keep to UTF-8
+// codepoint boundaries.
+class LineEditor
+{
+public:
+    // Applies an editing key from promptInputHandler, false for other keys
+    bool handle(char key);
+
+    void insert(char c);
+    void insert(const string &text);
+    void erase();        // codepoint before the cursor
+    void eraseForward(); // codepoint after the cursor
+    void left();
+    void right();
+    void wordLeft();
+    void wordRight();
+
+    void clear();
+    // Replaces the text, the cursor goes to the end
+    void set(const string &text);
+
+    string text() const;
+    // Bytes [from, to) of the text
+    string slice(size_t from, size_t to) const;
+    char at(size_t i) const { return i < gapStart ? buffer[i] : buffer[i + gapEnd - gapStart]; }
+    size_t size() const { return buffer.size() - (gapEnd - gapStart); }
+    bool empty() const { return size() == 0; }
+    size_t cursor() const { return gapStart; }
+    // Bumped on every change, lets the screen skip unchanged repaints
+    uint32_t revision() const { return changes; }
+
+private:
+    void moveTo(size_t position);
+    void reserve(size_t bytes);
+
+    vector<char> buffer;
+    size_t gapStart = 0;
+    size_t gapEnd = 0;
+    uint32_t changes = 0;
+};
+
+#endif // LINEEDITOR_H
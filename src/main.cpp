@@ -1,15 +1,29 @@
 #include <ArduinoJson.h>
 #include <M5Cardputer.h>
 #include <WiFiClientSecure.h>
+#include <esp_heap_caps.h>
 
 #include "MessageJarCardputerLogo.h"
 #include "SdService.h"
+#include "appstate.h"
+#include "connpool.h"
 #include "display.h"
 #include "event.h"
+#include "glyphcache.h"
+#include "history.h"
+#include "metrics.h"
+#include "packedimage.h"
+#include "power.h"
 #include "input.h"
+#include "lineeditor.h"
 #include "messagejar.h"
+#include "profile.h"
+#include "sdwriter.h"
+#include "tasks.h"
+#include "telemetry.h"
 
 #include <atomic>
+#include <map>
 #include <mutex>
 #include <string>
 #include <thread>
@@ -30,45 +44,92 @@ string TOKEN = "";
 std::atomic<bool> receiveDataFlag(false);
 std::atomic<bool> running(true);
 
-// Strings for serial send/receive
-std::string sendString;
+// Message being typed and messages received
+LineEditor prompt;
 std::string receiveString;
 
-// Lock receiveString and User for thread safe purpose
+// Lock receiveString and the account's user for thread safe purpose
 std::mutex receiveMutex;
 std::mutex userMutex;
 
-// MessageJar instance
-MessageJar *User = nullptr;
+// Entering a room bumps the session, a message task of an earlier one stores
+// nothing after that. sessionMutex orders the two.
+std::atomic<uint32_t> roomSession(0);
+std::mutex sessionMutex;
+
+// Room list prefetch state. Leaving the list bumps the session, a prefetch
+// task of an earlier one ends after its fetch and stores it only while the
+// session is still its own, under sessionMutex like a message task.
+std::atomic<uint32_t> prefetchSession(0);
+std::mutex wantedMutex;
+vector<string> wantedRooms;
 
 // SdService instance
 SdService SDCard;
+SdWriter sdWriter(SDCard);
 
-void logout() {
-  auto configData = SDCard.readFile(CONFIG_FILE_PATH);
-  JsonDocument doc;
-  DeserializationError error = deserializeJson(doc, configData);
+// Non-ASCII glyphs, from a font on the SD card
+GlyphCache glyphs(SDCard);
+
+// Server, user, history, drafts and outbox of each profile used so far,
+// `account` is the one in use
+std::map<string, unique_ptr<Account>> accounts;
+Account *account = nullptr;
+bool offline = false;
+
+// The step loop() runs, a step that fails leaves `failure` to show
+AppState state = STATE_STORAGE;
+string failure;
+string currentRoom;
 
-  doc["token"] = "";
+bool fail(const string &why) {
+  failure = why;
+  return false;
+}
+
+bool read_config(JsonDocument &doc) {
+  if (deserializeJson(doc, SDCard.readFile(CONFIG_FILE_PATH))) {
+    return fail("Malformed config!");
+  }
+  return true;
+}
 
+void save_config(JsonDocument &doc) {
   string output;
   serializeJson(doc, output);
-
   SDCard.writeFile(CONFIG_FILE_PATH, output.c_str());
+}
+
+void logout() {
+  JsonDocument doc;
+  if (read_config(doc)) {
+    profileSettings(doc, account->name)["token"] = "";
+    save_config(doc);
+  }
   if (confirm("Do you want to revoke  this token?")) {
-    User->revoke();
+    account->user->revoke();
   }
   showMessage("Rebooting...");
   delay(100);
   ESP.restart();
 }
 
+// Queues the message for the outbox task, which sends it on core 0 together
+// with anything else typed or pasted within OUTBOX_COALESCE ms
 void send(string message, string room) {
-  std::lock_guard<std::mutex> lock(userMutex);
-  User->send(room, message);
+  account->outbox.enqueue(room, message);
+  size_t queued = account->outbox.pending();
+  telemetry.publishQueue(queued);
+  if (WiFi.status() != WL_CONNECTED || account->outbox.stalled()) {
+    displayTerminalNotice("Offline, " + std::to_string(queued) +
+                          " message(s) queued");
+  }
 }
 
-std::pair<string, string> connect_to_wifi(std::map<string, string> config) {
+// Connects to a network picked from a scan, `creds` gets its SSID and
+// password when they are new. Fails when the user declines to go on offline.
+bool connect_to_wifi(std::map<string, string> config,
+                     std::pair<string, string> &creds) {
 
   vector<string> foundSSIDs;
   string SSID = "";
@@ -83,7 +144,7 @@ std::pair<string, string> connect_to_wifi(std::map<string, string> config) {
   }
 
   foundSSIDs.push_back("Enter SSID...");
-  int ssidIndex = selectFromList(foundSSIDs);
+  size_t ssidIndex = selectFromList(foundSSIDs);
   if (ssidIndex == foundSSIDs.size() - 1) {
     SSID = getInput("SSID");
   } else {
@@ -112,151 +173,394 @@ std::pair<string, string> connect_to_wifi(std::map<string, string> config) {
 
   if (WiFi.status() != WL_CONNECTED) {
     showMessage("Connection failed");
+    delay(1000);
 
-
-    while(true) {
-      delay(1000);
+    // WiFi keeps trying in the background, queued messages go out once it is up
+    if (!confirm("No connection. Continue offline?")) {
+      // RETRY scans again, BACK rereads the config
+      return fail("No WiFi");
     }
+    offline = true;
   }
 
   // return the wifi password if it was not in the config
 
   if (config.find(SSID) == config.end()) {
-    return {SSID, password};
+    creds = {SSID, password};
   }
-
-  return {"", ""};
+  return true;
 }
 
-void connect_user(JsonDocument &doc, MessageJar *&user) {
+bool connect_user(JsonDocument &doc, Account &profile) {
+
+  JsonVariant settings = profileSettings(doc, profile.name);
+  string token =
+      settings["token"].is<const char *>() ? settings["token"].as<string>() : "";
+  profile.user.reset(new MessageJar(profile.server, token));
+  MessageJar *user = profile.user.get();
+
+  // pins that are configured but unusable stop the login, the account would
+  // not reach its server anyway
+  if (!profile.server.pool.refusal().empty()) {
+    return fail(profile.server.pool.refusal());
+  }
+  // before a password is typed, once per account. The metrics count every
+  // unverified connection.
+  if (!profile.server.pool.verified()) {
+    showMessage("Server not verified!");
+    delay(1000);
+  }
 
-  string token = doc["token"].as<string>();
-  user = new MessageJar(token);
+  // a token that cannot be checked for lack of a connection is kept
+  ResponseStatus status = RESPONSE_API_ERROR;
+  if (!token.empty()) {
+    status = offline ? RESPONSE_TRANSPORT_ERROR : user->check();
+  }
+  if (status == RESPONSE_TRANSPORT_ERROR) {
+    offline = true;
+  }
 
-  if (token.empty() || !user->check()) {
+  if (status == RESPONSE_API_ERROR) {
     string username = getInput("Username");
     string password = "";
     string token = "";
 
-    if (MessageJar::user_exists(username)) {
+    if (MessageJar::user_exists(profile.server, username)) {
       password = getInput("Log in");
     } else {
       password = getInput("Create account");
       string password2 = getInput("Confirm password");
       if (password != password2) {
-        showMessage("Passwords don't match!");
-        while (true) {
-          delay(1000);
-        }
+        return fail("Passwords don't match!");
       }
-      if (!MessageJar::create_user(username, password)) {
-        showMessage("User creation failed!");
-        while (true) {
-          delay(1000);
-        }
+      if (MessageJar::create_user(profile.server, username, password) !=
+          RESPONSE_OK) {
+        return fail("User creation failed!");
       }
     }
 
     int num = (esp_random() % 900) + 100; // number between 100 and 999
     string name = "Cardputer-" + std::to_string(num);
-    token = MessageJar::generate_token(username, password, name);
+    token = MessageJar::generate_token(profile.server, username, password,
+                                       name);
     if (token.empty()) {
-      showMessage("Log in fail");
-      while (true) {
-        delay(1000);
-      }
+      return fail("Log in fail");
     }
-    doc["token"] = token;
-    string output;
-    serializeJson(doc, output);
-    SDCard.writeFile(CONFIG_FILE_PATH, output.c_str());
-    delete user;
-    user = new MessageJar(token);
+    settings["token"] = token;
+    save_config(doc);
+    profile.user.reset(new MessageJar(profile.server, token));
   }
+  return true;
 }
 
-void config() {
-  auto configData = SDCard.readFile(CONFIG_FILE_PATH);
+// Makes `name` the profile in use, loading and logging in to it the first
+// time. The accounts left behind keep their state but not their connections.
+// On failure the profile in use stays as it was.
+bool use_profile(JsonDocument &doc, const string &name) {
+  auto found = accounts.find(name);
+  if (found == accounts.end()) {
+    unique_ptr<Account> created(
+        new Account(SDCard, name, profileSettings(doc, name)));
+    created->load();
+    // connect_user checked the token, or logged in for a new one
+    if (!connect_user(doc, *created)) {
+      return false;
+    }
+    found = accounts.emplace(name, std::move(created)).first;
+
+    // sends this profile's queue even after another one is picked
+    Account *added = found->second.get();
+    startTask(outboxTask, "Outbox", TASK_STACK_OUTBOX,
+              new OutboxTaskParams{&added->outbox, &userMutex, added->user.get()},
+              TASK_PRIORITY_NETWORK, NETWORK_CORE);
+  }
+
+  account = found->second.get();
+  for (auto &item : accounts) {
+    if (item.second.get() != account) {
+      item.second->server.pool.closeIdle();
+    }
+  }
+  telemetry.publishQueue(account->outbox.pending());
+  account->server.breaker.publish();
+  return true;
+}
 
+// Picks another profile, or adds one, and switches to it without a reboot
+bool switch_profile() {
   JsonDocument doc;
-  JsonDocument WIFI_CREDS;
-  DeserializationError error = deserializeJson(doc, configData);
-  std::map<string, string> wifiMap;
+  if (!read_config(doc)) {
+    return false;
+  }
 
-  if (error) {
-    showMessage("Malformed config!");
-    while (true) {
-      delay(1000);
+  vector<string> names = profileNames(doc);
+  size_t current = 0;
+  for (size_t i = 0; i < names.size(); ++i) {
+    if (names[i] == account->name) {
+      current = i;
     }
   }
+  names.push_back("+ New profile...");
+
+  size_t num = selectFromList(names, current);
+  string name;
+  if (num == names.size() - 1) {
+    name = getInput("Profile name");
+    if (name.empty()) {
+      return true;
+    }
+    migrateProfiles(doc);
+    if (!doc["profiles"][name].is<JsonObject>()) {
+      // empty for the default server
+      string server = getInput("Server URL");
+      JsonObject settings = doc["profiles"][name].to<JsonObject>();
+      if (!server.empty()) {
+        settings["server"] = server;
+      }
+    }
+  } else {
+    name = names[num];
+  }
+  if (name == account->name) {
+    return true;
+  }
+
+  // the boot default only changes once the profile works
+  if (!use_profile(doc, name)) {
+    return false;
+  }
+  doc["profile"] = name;
+  save_config(doc);
+  return true;
+}
 
-  WIFI_CREDS = doc["wifi"];
+bool start_storage() {
+  static bool started = false;
+  if (!SDCard.getSdState() && !SDCard.begin()) {
+    return fail("No SD card!");
+  }
+  if (started) {
+    return true;
+  }
+  started = true;
 
-  for (auto pair : WIFI_CREDS.as<JsonObject>()) {
+  if (glyphs.begin()) {
+    displaySetGlyphs(&glyphs);
+  }
+  sdWriter.begin();
+
+  M5Cardputer.Display.setSwapBytes(true);
+
+  std::vector<uint8_t> logo = SDCard.readBinaryFile(LOGO_PATH);
+  if (!drawPackedImage(logo.data(), logo.size(), 0, 0)) {
+    drawPackedImage(MessageJarLogo, sizeof(MessageJarLogo), 0, 0);
+  }
+  return true;
+}
+
+bool load_config() {
+  JsonDocument doc;
+  if (!read_config(doc)) {
+    return false;
+  }
+  if (doc["metrics_log"].as<bool>()) {
+    metrics.logTo(&sdWriter);
+  }
+  return true;
+}
+
+bool start_wifi() {
+  JsonDocument doc;
+  std::map<string, string> wifiMap;
+  if (!read_config(doc)) {
+    return false;
+  }
+
+  for (auto pair : doc["wifi"].as<JsonObject>()) {
     wifiMap[pair.key().c_str()] = pair.value().as<string>();
   }
 
-  std::pair<string, string> creds = connect_to_wifi(wifiMap);
+  offline = false;
+  std::pair<string, string> creds;
+  if (!connect_to_wifi(wifiMap, creds)) {
+    return false;
+  }
 
   if (!creds.first.empty()) {
     // Update the JSON document with the new credentials
     doc["wifi"][creds.first] = creds.second;
+    save_config(doc);
+  }
 
-    string output;
-    serializeJson(doc, output);
+  if (!offline) {
+    showMessage("WiFi connected!");
+  }
+  return true;
+}
 
-    SDCard.writeFile(CONFIG_FILE_PATH, output.c_str());
+// Logs in to the configured profile, or once one is in use, offers the
+// profile list again
+bool start_account() {
+  if (account) {
+    return switch_profile();
+  }
+  JsonDocument doc;
+  if (!read_config(doc)) {
+    return false;
   }
+  return use_profile(doc, currentProfile(doc));
+}
 
-  showMessage("WiFi connected!");
+void start_prefetch() {
+  uint32_t session = ++prefetchSession;
+  PrefetchTaskParams *params = new PrefetchTaskParams{
+      &prefetchSession,    session,           &sessionMutex,
+      &wantedMutex,        &wantedRooms,      &userMutex,
+      account->user.get(), &account->history, &account->cache,
+      &account->outbox,    &account->input,
+  };
 
-  connect_user(doc, User);
+  startTask(prefetchTask, "Prefetch", TASK_STACK_PREFETCH, params,
+            TASK_PRIORITY_NETWORK, NETWORK_CORE);
+}
 
-  if (!User->check()) {
-    showMessage("User auth failed!");
-    while (true) {
-      delay(1000);
-    }
+void stop_prefetch() {
+  {
+    std::lock_guard<std::mutex> lock(wantedMutex);
+    wantedRooms.clear();
   }
+  // a fetch in flight finishes in the background, the room entered next
+  // reads from the server itself when it missed the cache
+  ++prefetchSession;
 }
 
-string get_room() {
-  string ret;
+// Stack use of every task and the busy share of each core, refreshed each
+// second until a key is pressed
+void task_screen() {
+  unsigned long drawn = 0;
+  bool first = true;
+  measureCores(true);
+  while (true) {
+    char input = promptInputHandler();
+    if (input != KEY_NONE && !first) {
+      break;
+    }
+    first = false;
+    if (drawn && millis() - drawn < 1000) {
+      delay(50);
+      continue;
+    }
+    drawn = millis();
+
+    displayClearMainView();
+    M5.Lcd.setTextSize(1);
+    M5.Lcd.setTextColor(TEXT_COLOR);
+    M5.Lcd.setCursor(0, DEFAULT_MARGIN);
+    M5.Lcd.println("task      core prio  free/stack");
+    for (const auto &task : taskInfo()) {
+      M5.Lcd.printf("%-9.9s %4d %4u %5u/%-5u\n", task.name.c_str(),
+                    task.core, task.priority, (unsigned)task.freeStack,
+                    (unsigned)task.stack);
+    }
+    int busy[CORE_COUNT];
+    if (coreBusy(busy)) {
+      M5.Lcd.printf("\ncore 0 busy %d%%, core 1 busy %d%%\n", busy[0],
+                    busy[1]);
+    } else {
+      M5.Lcd.println("\ncore use from the next second");
+    }
+    M5.Lcd.printf("heap free %u, largest %u\n", (unsigned)ESP.getFreeHeap(),
+                  (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+    M5.Lcd.println("\nany key to go back");
+  }
+  measureCores(false);
+}
 
+// Sets `next` to STATE_ROOM with `room` chosen, or to STATE_ROOMS again
+// after one of the list's own screens
+bool choose_room(string &room, AppState &next) {
   showMessage("Getting rooms...");
 
-  auto rooms = User->get_rooms();
+  auto rooms = account->user->get_rooms();
+  if (rooms) {
+    account->history.storeRooms(*rooms);
+  } else {
+    rooms = account->history.rooms(); // offline, browse what was cached
+  }
+
   if (!rooms) {
-    showMessage("Error getting rooms!");
-    while (true) {
-      delay(1000);
-    }
+    return fail("Error getting rooms!");
   } else {
+    size_t roomCount = rooms->size();
     rooms->push_back("+ Create new room");
+    rooms->push_back("+ Profiles...");
+    rooms->push_back("+ Tasks...");
     rooms->push_back("+ Logout...");
-    int num = selectFromList(*rooms);
-    if (num == rooms->size() - 2) { // then we are creating a new room
-      ret = getInput("Room name");
-      if (!User->create_room(ret)) {
-        showMessage("Failed to make room");
-        for (;;)
-          delay(1000);
+
+    start_prefetch();
+    size_t num = selectFromList(*rooms, 0, [&](size_t index) {
+      std::lock_guard<std::mutex> lock(wantedMutex);
+      wantedRooms.clear();
+      for (size_t i = index; i < roomCount && i <= index + PREFETCH_AHEAD;
+           ++i) {
+        wantedRooms.push_back(rooms->at(i));
+      }
+    });
+    stop_prefetch();
+
+    next = STATE_ROOM;
+    if (num == rooms->size() - 4) { // then we are creating a new room
+      room = getInput("Room name");
+      if (account->user->create_room(room) != RESPONSE_OK) {
+        return fail("Failed to make room");
       }
+    } else if (num == rooms->size() - 3) {
+      next = STATE_ROOMS;
+      return switch_profile();
+    } else if (num == rooms->size() - 2) {
+      next = STATE_ROOMS;
+      task_screen();
     } else if (num == rooms->size() - 1) {
       logout();
     } else {
-      ret = rooms->at(num);
+      room = rooms->at(num);
     }
   }
-  return ret;
+  return true;
 }
 
-void terminal(string room) {
-  int16_t promptSize = -1;
+void terminal(string room, string messages) {
+  History &history = account->history;
+  InputStore &inputStore = account->input;
+  bool promptFull = true;
+  bool statusFull = true;
+  unsigned long statusDrawn = 0;
+  prompt.set(inputStore.draft(room));
+  uint32_t promptRevision = prompt.revision();
+  // sent message shown by ctrl+up/down, -1 while editing the draft
+  int recalled = -1;
+  string stashed;
   // int16_t terminalSize = -1;
   size_t scroll = 0;
-  bool redraw = false;
-  string messages = "";
+  size_t totalLines = 0;
+  bool redraw = !messages.empty();
+
+  // `messages` holds bytes [windowStart, windowEnd) of the room's history log,
+  // live means windowEnd is the end of the log
+  size_t windowEnd = history.size(room);
+  size_t windowStart =
+      windowEnd > messages.size() ? windowEnd - messages.size() : 0;
+  bool live = true;
+
+  auto trimFront = [&]() {
+    if (messages.size() > HISTORY_WINDOW) {
+      size_t cut = messages.find('\n', messages.size() - HISTORY_WINDOW);
+      if (cut != string::npos) {
+        messages.erase(0, cut + 1);
+        windowStart += cut + 1;
+      }
+    }
+  };
 
   while (running) {
     {
@@ -266,14 +570,25 @@ void terminal(string room) {
       case KEY_NONE:
         break;
       case KEY_OK:
-        send(sendString, room);
-        sendString.clear();
+        inputStore.remember(prompt.text());
+        send(prompt.text(), room);
+        prompt.clear();
+        recalled = -1;
+        break;
+      case KEY_HISTORY_UP:
+        if (recalled + 1 < (int)inputStore.recallSize()) {
+          if (recalled < 0) {
+            stashed = prompt.text();
+          }
+          prompt.set(inputStore.recall(++recalled));
+        }
         break;
-      case KEY_DEL: {
-        if (!sendString.empty()) {
-          sendString.pop_back();
+      case KEY_HISTORY_DOWN:
+        if (recalled >= 0) {
+          --recalled;
+          prompt.set(recalled < 0 ? stashed : inputStore.recall(recalled));
         }
-      } break;
+        break;
       case KEY_ARROW_DOWN: {
         if (scroll > 0) {
           --scroll;
@@ -282,7 +597,42 @@ void terminal(string room) {
         break;
       }
       case KEY_ARROW_UP: {
-        ++scroll;
+        if (scroll + TERMINAL_LINES < totalLines) {
+          ++scroll;
+          redraw = true;
+        }
+        break;
+      }
+      case KEY_TAB: {
+        string query = getInput("Search");
+        showMessage("Searching...");
+        // history the message task has not indexed yet is done here
+        vector<SearchHit> hits = account->search.search(
+            room, query, [](size_t done, size_t total) {
+              showMessage("Indexing " + std::to_string(done * 100 / total) +
+                          "%");
+            });
+        if (hits.empty()) {
+          showMessage("No matches");
+          delay(1000);
+        } else {
+          vector<string> lines;
+          for (const auto &hit : hits) {
+            lines.push_back(hit.text);
+          }
+          const SearchHit &hit = hits[selectFromList(lines)];
+
+          // reopen the window at the hit, older and newer pages load as usual
+          messages = history.after(room, hit.offset, HISTORY_PAGE);
+          windowStart = hit.offset;
+          windowEnd = windowStart + messages.size();
+          live = windowEnd >= history.size(room);
+          size_t count = displayLineCount(messages);
+          scroll = count > TERMINAL_LINES ? count - TERMINAL_LINES : 0;
+        }
+        displayClearMainView();
+        promptFull = true;
+        statusFull = true;
         redraw = true;
         break;
       }
@@ -292,9 +642,9 @@ void terminal(string room) {
         showMessage("Exiting...");
         break;
       }
-      default: {
-        sendString += input;
-      } break;
+      default:
+        prompt.handle(input);
+        break;
       }
     }
 
@@ -302,19 +652,74 @@ void terminal(string room) {
             false)) // if data has been be recived (receiveDataFlag)
     {
       std::lock_guard<std::mutex> lock(receiveMutex);
-      messages += receiveString;
+      // when scrolled away from the end the new messages are read back from
+      // the log on the way down
+      if (live) {
+        messages += receiveString;
+        windowEnd += receiveString.size();
+        if (scroll == 0) {
+          trimFront();
+        }
+        redraw = true;
+      }
       receiveString.clear();
-      redraw = true;
     }
 
-    if (promptSize != sendString.size()) {
-      displayPrompt(sendString);
-      promptSize = sendString.size();
+    if (statusFull || millis() - statusDrawn >= STATUS_INTERVAL) {
+      displayStatusBar(statusFull);
+      statusFull = false;
+      statusDrawn = millis();
+    }
+
+    if (promptFull || promptRevision != prompt.revision()) {
+      if (promptRevision != prompt.revision()) {
+        // memory only, the store writes drafts out in the background
+        inputStore.setDraft(room, prompt.text());
+      }
+      displayPrompt(prompt, promptFull);
+      promptFull = false;
+      promptRevision = prompt.revision();
     }
 
     if (redraw) {
-      displayTerminal(messages, scroll);
+      totalLines = displayTerminal(messages, scroll);
       redraw = false;
+
+      if (windowStart > 0 &&
+          scroll + TERMINAL_LINES + HISTORY_MARGIN >= totalLines) {
+        // the top is coming into view, page older history in from the SD card
+        displayTerminalNotice("Loading history...");
+        size_t start;
+        string page = history.before(room, windowStart, HISTORY_PAGE, start);
+        if (page.empty()) {
+          windowStart = 0;
+        } else {
+          messages.insert(0, page);
+          windowStart = start;
+        }
+
+        if (messages.size() > HISTORY_WINDOW) {
+          // drop the newest lines, they are reloaded on the way down
+          size_t keep = messages.rfind('\n', HISTORY_WINDOW - 1);
+          if (keep != string::npos) {
+            size_t dropped = displayLineCount(messages.substr(keep + 1));
+            scroll -= std::min(scroll, dropped);
+            messages.erase(keep + 1);
+            windowEnd = windowStart + messages.size();
+            live = false;
+          }
+        }
+        redraw = true;
+      } else if (!live && scroll < HISTORY_MARGIN) {
+        displayTerminalNotice("Loading history...");
+        string page = history.after(room, windowEnd, HISTORY_PAGE);
+        messages += page;
+        windowEnd += page.size();
+        scroll += displayLineCount(page);
+        live = page.empty() || windowEnd >= history.size(room);
+        trimFront();
+        redraw = true;
+      }
     }
 
     delay(100);
@@ -326,45 +731,76 @@ void setup() {
   M5Cardputer.begin(cfg);
 
   displayInit();
+  power.begin();
+  registerTask("UI", TASK_STACK_UI, xPortGetCoreID());
+}
 
-  if (!SDCard.begin()) {
-    {
-      showMessage("No SD card!");
-      while (true) {
-        delay(1000);
-      }
+void enter_room(const string &room) {
+  // the last room's message task may still be finishing a poll, leaving
+  // cancelled it and the new session keeps it from storing anything
+  uint32_t session;
+  RoomSnapshot snapshot;
+  History &history = account->history;
+  {
+    std::lock_guard<std::mutex> lock(sessionMutex);
+    session = ++roomSession;
+    if (!account->cache.take(room, snapshot)) {
+      // start from the SD copy of the room and only fetch what is new
+      size_t start;
+      snapshot.latest = history.count(room);
+      snapshot.text =
+          history.before(room, history.size(room), HISTORY_PAGE, start);
     }
   }
-
-  M5Cardputer.Display.setSwapBytes(true);
-
-  M5Cardputer.Display.pushImage(0, 0, 240, 135, MessageJarLogo);
-
-  // config
-  config();
-}
-
-void loop() {
-
-  string room = get_room();
+  {
+    std::lock_guard<std::mutex> lock(receiveMutex);
+    receiveString.clear();
+    receiveDataFlag = false;
+  }
   running = true;
 
+  shared_ptr<Cancellation> cancel = make_shared<Cancellation>();
   MessageTaskParams *params = new MessageTaskParams{
-      &receiveDataFlag, &receiveString, &running, &receiveMutex,
-      &userMutex,       User,           room,
+      &receiveDataFlag,     &receiveString,        &running,
+      &receiveMutex,        &userMutex,            account->user.get(),
+      &history,             room,                  snapshot.latest,
+      &account->transport,  account->pollInterval, &roomSession,
+      session,              &sessionMutex,         &account->outbox,
+      &account->input,      &account->search,      cancel,
   };
 
-  xTaskCreate(     // Using xTaskCreate to manage memory better
-      messageTask, // Function to run
-      "MsgTask",   // Name (for debugging)
-      8192,        // Stack size (in bytes)
-      params,      // Parameter to pass
-      1,           // Priority
-      NULL         // Task handle
+  startTask(messageTask,           // Function to run
+            "MsgTask",             // Name (for debugging)
+            TASK_STACK_MESSAGE,    // Stack size (in bytes)
+            params,                // Parameter to pass
+            TASK_PRIORITY_NETWORK, // Priority
+            NETWORK_CORE           // TLS stays off the UI core
   );
 
   displayClearMainView();
-  showMessage("Loading messages...");
-  terminal(room);
-  // if we are here the user pressed esc
+  if (snapshot.text.empty()) {
+    showMessage("Loading messages...");
+  }
+  terminal(room, snapshot.text);
+  // if we are here the user pressed esc, a long poll need not run out
+  cancel->cancel();
 }
+
+// The steps on the board
+class BoardSteps : public StartSteps {
+public:
+  bool startStorage() override { return start_storage(); }
+  bool loadConfig() override { return load_config(); }
+  bool startWifi() override { return start_wifi(); }
+  bool startAccount() override { return start_account(); }
+  bool chooseRoom(AppState &next) override {
+    return choose_room(currentRoom, next);
+  }
+  void enterRoom() override { enter_room(currentRoom); }
+  bool retry() override { return confirm(::failure, "RETRY", "BACK"); }
+  const string &failure() const override { return ::failure; }
+};
+
+BoardSteps steps;
+
+void loop() { state = runStep(steps, state); }
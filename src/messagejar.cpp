@@ -1,11 +1,14 @@
 #include "messagejar.h"
+#include "connpool.h"
 #include "display.h"
+#include "endpoints.h"
+#include "inflate.h"
+#include "metrics.h"
 
 #include <ArduinoJson.h>
 #include <HTTPClient.h>
 #include <WiFi.h>
 
-#include <map>
 #include <memory>
 #include <string>
 #include <vector>
@@ -16,83 +19,264 @@ using std::string;
 using std::unique_ptr;
 using std::vector;
 
-#define SERVER_URL "https://messagejar.pythonanywhere.com/api/v1"
-
-bool check_resp(const std::string &resp) {
-  // 1. Find the first non-whitespace character (the opening '{')
-  auto first = std::find_if(resp.begin(), resp.end(),
-                            [](unsigned char ch) { return !std::isspace(ch); });
-
-  // If string is empty or only whitespace
-  if (first == resp.end() || *first != '{') {
-    return true;
+// Appends everything written to it to a string. HTTPClient::writeToStream
+// wants a Stream, the read side is always empty.
+class StringSink : public Stream {
+public:
+  StringSink(string &out) : out(out) {}
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+  size_t write(uint8_t c) override {
+    out += (char)c;
+    return 1;
+  }
+  size_t write(const uint8_t *buffer, size_t size) override {
+    out.append((const char *)buffer, size);
+    return size;
   }
 
-  // 2. Look for the "e" key immediately following the '{'
-  // We skip whitespace again in case there is a space after the '{'
-  auto after_brace = std::next(first);
-  auto key_start = std::find_if(after_brace, resp.end(), [](unsigned char ch) {
-    return !std::isspace(ch);
-  });
+private:
+  string &out;
+};
 
-  // Check if the next sequence is "e":
-  const std::string error_key = "\"e\":";
+// "https://host:port/path" -> "host" and port, 443 when there is none
+static string url_host(const string &url) {
+  size_t start = url.find("://");
+  start = start == string::npos ? 0 : start + 3;
+  size_t end = url.find_first_of(":/", start);
+  return url.substr(start, end == string::npos ? string::npos : end - start);
+}
 
-  // Check if the remaining string is long enough and matches
-  if (std::distance(key_start, resp.end()) >= error_key.size()) {
-    if (std::equal(error_key.begin(), error_key.end(), key_start)) {
-      return false;
-    }
+static uint16_t url_port(const string &url) {
+  size_t start = url.find("://");
+  start = start == string::npos ? 0 : start + 3;
+  size_t colon = url.find_first_of(":/", start);
+  if (colon == string::npos || url[colon] != ':') {
+    return 443;
   }
+  return (uint16_t)atoi(url.c_str() + colon + 1);
+}
 
-  return true;
+Server::Server(const string &url)
+    : pool(url_host(url), url_port(url)), baseUrl(url) {
+  // endpoints start with '/'
+  while (!baseUrl.empty() && baseUrl.back() == '/') {
+    baseUrl.pop_back();
+  }
+  for (int id = 0; id < ENDPOINT_COUNT; ++id) {
+    endpointUrls[id] = baseUrl + ENDPOINTS[id].path;
+  }
 }
 
-unique_ptr<string> request(const string &endpoint,
-                           const std::map<string, string> &kv) {
-  WiFiClientSecure client;
-  client.setInsecure();
+bool request(Server &server, EndpointId id, const RequestBody &body,
+             string &response, uint16_t timeout, int *status,
+             Cancellation *cancel) {
+  ScopedTiming total(TIMING_REQUEST);
+  metrics.add(COUNTER_REQUESTS);
 
-  HTTPClient http;
-  string url = string(SERVER_URL) + endpoint;
+  const string &url = server.url(id);
 
-  JsonDocument doc;
+  // stream the body straight into the caller's buffer, no Arduino String
+  response.clear();
+  if (response.capacity() > RESPONSE_BUFFER_KEEP) {
+    string().swap(response);
+  }
 
-  for (const auto &item : kv) {
-    doc[item.first] = item.second;
+  bool reused;
+  PoolClient *client = server.pool.acquire(reused);
+  if (!client) {
+    return false;
+  }
+  if (cancel && !cancel->watch(client)) {
+    server.pool.release(client, true);
+    return false;
   }
 
-  String jsonBody;
-  serializeJson(doc, jsonBody);
+  HTTPClient http;
+  http.setReuse(true);
+  http.begin(*client, url.c_str());
+  if (timeout) {
+    http.setTimeout(timeout);
+  }
 
-  http.begin(client, url.c_str());
+  // compressed answers only when the inflate buffers are free for this one
+  InflateLease lease;
+  const char *encodings = lease.held() ? "gzip, deflate" : "identity";
 
+  const char *collect[] = {"Content-Encoding"};
+  http.collectHeaders(collect, 1);
   http.addHeader("Content-Type", "application/json");
-  int httpCode = http.POST(jsonBody);
+  // replaces HTTPClient's own "identity", so the server may compress history
+  http.setAcceptEncoding(encodings);
+  unsigned long start = micros();
+  int httpCode = http.POST((uint8_t *)body.data(), body.size());
 
-  if (httpCode > 0) {
-    String payload = http.getString();
-    auto result = unique_ptr<string>(new string(payload.c_str()));
+  if (httpCode <= 0 && reused && !(cancel && cancel->cancelled())) {
+    // the server dropped the kept connection, once more on a fresh one
     http.end();
-    return result;
+    if (cancel) {
+      cancel->watch(nullptr);
+    }
+    server.pool.release(client, false);
+    client = server.pool.acquire(reused);
+    if (!client) {
+      return false;
+    }
+    if (cancel && !cancel->watch(client)) {
+      server.pool.release(client, true);
+      return false;
+    }
+    http.begin(*client, url.c_str());
+    http.addHeader("Content-Type", "application/json");
+    http.setAcceptEncoding(encodings);
+    start = micros();
+    httpCode = http.POST((uint8_t *)body.data(), body.size());
+  }
+  metrics.record(TIMING_SERVER, micros() - start);
+  metrics.add(COUNTER_BYTES_OUT, body.size());
+  if (status) {
+    *status = httpCode;
+  }
+
+  int written = -1;
+  if (httpCode > 0) {
+    start = micros();
+    StringSink sink(response);
+    String encoding = http.header("Content-Encoding");
+    if (encoding == "gzip" || encoding == "deflate") {
+      Inflater inflater(lease, sink, encoding == "gzip");
+      written = inflater.ok() ? http.writeToStream(&inflater) : -1;
+      if (!inflater.finished()) {
+        written = -1;
+      }
+      metrics.add(COUNTER_BYTES_IN, inflater.compressedBytes());
+    } else {
+      written = http.writeToStream(&sink);
+      metrics.add(COUNTER_BYTES_IN, response.size());
+    }
+    metrics.record(TIMING_DOWNLOAD, micros() - start);
+    metrics.add(COUNTER_BYTES_DECODED, response.size());
   }
 
+  // a body read to the end leaves the connection ready for the next request
   http.end();
-  return nullptr;
+  if (cancel) {
+    cancel->watch(nullptr);
+  }
+  server.pool.release(client, written >= 0);
+  // a server error is a failure to deliver, the body is read so the
+  // connection stays usable
+  if (written >= 0 && httpCode < 500) {
+    return true;
+  }
+
+  metrics.add(COUNTER_REQUEST_ERRORS);
+  return false;
+}
+
+ResponseStatus decode_response(bool delivered, int code, const string &body,
+                               JsonDocument &doc, bool needsBody,
+                               string *error) {
+  if (!delivered) {
+    return RESPONSE_TRANSPORT_ERROR;
+  }
+
+  ScopedTiming parse(TIMING_PARSE);
+  bool parsed = !deserializeJson(doc, body);
+  if (!parsed) {
+    doc.clear();
+  }
+  // errors are an object with an "e" key, wherever the key sits
+  JsonVariantConst e = doc.as<JsonObjectConst>()["e"];
+
+  ResponseStatus status =
+      classify_response(delivered, code, parsed, !e.isNull(), needsBody);
+  if (status == RESPONSE_TRANSPORT_ERROR) {
+    metrics.add(COUNTER_PARSE_ERRORS);
+  } else if (status == RESPONSE_API_ERROR && error) {
+    // without an "e", an error page from the server or a proxy before it
+    *error = e.isNull() ? "HTTP " + std::to_string(code) : e.as<string>();
+  }
+  return status;
 }
 
-Message::Message(const std::map<string, string> &data) {
-  try {
-    author = data.at("author");
-    content = data.at("content");
-    timestamp = data.at("created");
-    message_id = data.at("id");
-  } catch (const std::out_of_range &) {
-    author = "";
+// Every API call ends here: `body`, already written for endpoint `id`, is
+// posted and the answer decoded once into `doc` and checked against what the
+// endpoint promises. Transport errors are retried as the endpoint allows,
+// with jittered backoff, unless the request was cancelled or the server's
+// breaker opened meanwhile. The breaker sees the call as one success or
+// failure, whatever its retries did.
+static inline ResponseStatus exchange(Server &server, EndpointId id,
+                                      const RequestBody &body,
+                                      string &response, JsonDocument &doc,
+                                      uint16_t timeout = 0,
+                                      int *status = nullptr,
+                                      Cancellation *cancel = nullptr) {
+  const Endpoint &endpoint = ENDPOINTS[id];
+  if (!server.breaker.allow()) {
+    metrics.add(COUNTER_BREAKER_REJECTS);
+    return RESPONSE_TRANSPORT_ERROR;
+  }
+
+  for (uint8_t attempt = 0;; ++attempt) {
+    int code = 0;
+    bool delivered =
+        request(server, id, body, response,
+                timeout ? timeout : endpoint.timeout, &code, cancel);
+    if (status) {
+      *status = code;
+    }
+    if (cancel && cancel->cancelled()) {
+      // the caller gave up on it, not the server's failure
+      return RESPONSE_TRANSPORT_ERROR;
+    }
+    ResponseStatus result =
+        decode_response(delivered, code, response, doc, endpoint.needsBody);
+    if (result == RESPONSE_OK &&
+        !endpoint.check(doc.as<JsonVariantConst>())) {
+      metrics.add(COUNTER_PARSE_ERRORS);
+      result = RESPONSE_TRANSPORT_ERROR;
+    }
+
+    if (result != RESPONSE_TRANSPORT_ERROR) {
+      server.breaker.success();
+      return result;
+    }
+    // other calls failing meanwhile may have opened it
+    if (attempt >= endpoint.retries ||
+        server.breaker.state() == BREAKER_OPEN) {
+      server.breaker.failure();
+      return result;
+    }
+
+    // somewhere in the upper half of the backoff
+    uint32_t backoff = RETRY_BACKOFF << attempt;
+    delay(backoff - esp_random() % (backoff / 2));
+    metrics.add(COUNTER_RETRIES);
+  }
+}
+
+// The usual call, a body of the endpoint's fields with `values`
+static inline ResponseStatus call(Server &server, EndpointId id,
+                                  RequestBody &body,
+                                  std::initializer_list<BodyValue> values,
+                                  JsonDocument &doc) {
+  body.build(ENDPOINTS[id].fields, values);
+  string response;
+  return exchange(server, id, body, response, doc);
+}
+
+Message::Message(JsonObjectConst data) {
+  if (data["author"].isNull() || data["content"].isNull() ||
+      data["created"].isNull() || data["id"].isNull()) {
     content = "error parsing message";
-    timestamp = "";
-    message_id = "";
+    return;
   }
+  author = data["author"].as<string>();
+  content = data["content"].as<string>();
+  timestamp = data["created"].as<string>();
+  message_id = data["id"].as<string>();
 }
 
 string Message::as_string() const {
@@ -100,35 +284,39 @@ string Message::as_string() const {
   return author + ": " + content + "\n";
 }
 
-MessageJar::MessageJar(string token) : token(token) {}
+void Message::append_to(string &out) const {
+  out += author;
+  out += ": ";
+  out += content;
+  out += '\n';
+}
 
-bool MessageJar::check() {
-  auto response = request("/token/username", {{"token", token}});
-  if (!response || !check_resp(*response)) {
-    return false;
-  }
-  return true;
+MessageJar::MessageJar(Server &server, const string &token)
+    : server(server), token(token) {}
+
+ResponseStatus MessageJar::check() {
+  JsonDocument doc;
+  std::lock_guard<std::mutex> lock(callMutex);
+  return call(server, ENDPOINT_USERNAME, body, {token}, doc);
 }
 
-bool MessageJar::create_user(string username, string password) {
-  auto response =
-      request("/user/new", {{"username", username}, {"password", password}});
-  if (!response || !check_resp(*response)) {
-    return false;
-  }
-  return true;
+ResponseStatus MessageJar::create_user(Server &server, const string &username,
+                                       const string &password) {
+  JsonDocument doc;
+  RequestBody body;
+  return call(server, ENDPOINT_USER_NEW, body, {username, password}, doc);
 }
 
 shared_ptr<vector<string>> MessageJar::get_rooms() {
-
-  auto response = request("/rooms/list", {{"token", token}});
-  if (!response || !check_resp(*response)) {
-    return nullptr;
+  JsonDocument doc;
+  {
+    std::lock_guard<std::mutex> lock(callMutex);
+    if (call(server, ENDPOINT_ROOMS_LIST, body, {token}, doc) != RESPONSE_OK) {
+      return nullptr;
+    }
   }
 
   auto rooms = make_shared<vector<string>>();
-  JsonDocument doc;
-  deserializeJson(doc, response->c_str()); // TODO check for error
   JsonArray arr = doc.as<JsonArray>();
   for (JsonVariant v : arr) {
     rooms->push_back(v.as<string>());
@@ -137,72 +325,179 @@ shared_ptr<vector<string>> MessageJar::get_rooms() {
   return rooms;
 }
 
-shared_ptr<vector<Message>> MessageJar::get_messages(string room, int latest) {
+ResponseStatus MessageJar::get_messages(const string &room, size_t latest,
+                                        vector<Message> &out, Arena &arena,
+                                        PollBuffers &buffers,
+                                        unsigned int wait,
+                                        Cancellation *cancel) {
+  out.clear();
+
+  const BodyFields &fields = ENDPOINTS[ENDPOINT_GET].fields;
+  uint16_t timeout = 0;
+  if (wait) {
+    // ask the server to hold the request until something arrives
+    buffers.body.build(fields,
+                       {token, room, (uint32_t)latest, (uint32_t)wait});
+    timeout = (wait + 10) * 1000;
+  } else {
+    buffers.body.build(fields, {token, room, (uint32_t)latest});
+  }
 
-  auto response = request(
-      "/get",
-      {{"token", token}, {"room", room}, {"latest", std::to_string(latest)}});
-  if (!response || !check_resp(*response)) {
-    return nullptr;
+  // both documents live in the poll arena, the caller resets it
+  JsonDocument doc(&arena);
+  ResponseStatus status =
+      exchange(server, ENDPOINT_GET, buffers.body, buffers.response, doc,
+               timeout, nullptr, cancel);
+  if (status != RESPONSE_OK) {
+    return status;
   }
 
-  auto messages = make_shared<vector<Message>>();
-  JsonDocument doc;
-  deserializeJson(doc, response->c_str());
-  JsonArray arr = doc.as<JsonArray>(); // TODO check for error
+  ScopedTiming parse(TIMING_PARSE);
+  JsonDocument msg_doc(&arena);
+  JsonArray arr = doc.as<JsonArray>();
+  out.reserve(arr.size());
   for (JsonVariant v : arr) {
-    std::map<string, string> msg_data;
-    JsonDocument msg_doc;
-    deserializeJson(msg_doc, v.as<string>().c_str());
-    for (auto pair : msg_doc.as<JsonObject>()) {
-      msg_data[pair.key().c_str()] = pair.value().as<string>();
+    if (v.is<JsonObject>()) {
+      out.emplace_back(v.as<JsonObjectConst>());
+      continue;
     }
-    messages->push_back(Message(msg_data));
+    // usually each message is itself a JSON encoded string. One that is
+    // neither still takes its place, `latest` counts every message.
+    const char *text = v.as<const char *>();
+    if (!text || deserializeJson(msg_doc, text)) {
+      metrics.add(COUNTER_PARSE_ERRORS);
+      out.emplace_back(JsonObjectConst());
+      continue;
+    }
+    out.emplace_back(msg_doc.as<JsonObjectConst>());
   }
 
-  return messages;
+  return RESPONSE_OK;
 }
 
-bool MessageJar::send(string room, string content) {
+bool MessageJar::open_stream(const string &room, size_t latest,
+                             WiFiClientSecure &client, HTTPClient &http,
+                             RequestBody &body, bool &unsupported) {
+  unsupported = false;
+  if (!server.breaker.allow()) {
+    metrics.add(COUNTER_BREAKER_REJECTS);
+    return false;
+  }
+  metrics.add(COUNTER_REQUESTS);
 
-  auto response = request(
-      "/send", {{"token", token}, {"room", room}, {"message", content}});
-  return (response && check_resp(*response));
-}
+  if (!server.pool.connect(client)) {
+    server.breaker.failure();
+    return false;
+  }
+
+  // HTTP/1.0 so the server streams the events without chunked encoding
+  http.useHTTP10(true);
+  const Endpoint &endpoint = ENDPOINTS[ENDPOINT_STREAM];
+  http.begin(client, server.url(ENDPOINT_STREAM).c_str());
+  http.setTimeout(endpoint.timeout);
+
+  const char *collect[] = {"Content-Type"};
+  http.collectHeaders(collect, 1);
+  http.addHeader("Content-Type", "application/json");
+  http.addHeader("Accept", "text/event-stream");
 
-bool MessageJar::create_room(string room_name) {
-  auto response =
-      request("/rooms/create", {{"token", token}, {"room", room_name}});
-  if (!response || !check_resp(*response)) {
+  body.build(endpoint.fields, {token, room, (uint32_t)latest});
+  int httpCode = http.POST((uint8_t *)body.data(), body.size());
+  metrics.add(COUNTER_BYTES_OUT, body.size());
+
+  if (httpCode <= 0 || httpCode >= 500) {
+    metrics.add(COUNTER_REQUEST_ERRORS);
+    server.breaker.failure();
+    http.end();
     return false;
   }
-  return (response && check_resp(*response));
+  server.breaker.success();
+
+  if (httpCode != HTTP_CODE_OK ||
+      !http.header("Content-Type").startsWith("text/event-stream")) {
+    unsupported = true;
+    http.end();
+    return false;
+  }
+  return true;
+}
+
+ResponseStatus MessageJar::send(const string &room, const string &content,
+                                int *status) {
+  JsonDocument doc;
+  std::lock_guard<std::mutex> lock(callMutex);
+  body.build(ENDPOINTS[ENDPOINT_SEND].fields, {token, room, content});
+  string response;
+  return exchange(server, ENDPOINT_SEND, body, response, doc, 0, status);
+}
+
+ResponseStatus MessageJar::send_batch(
+    const vector<std::pair<string, string>> &messages) {
+  std::lock_guard<std::mutex> lock(callMutex);
+  // {"token": ..., "messages": [{"room": ..., "message": ...}, ...]}
+  body.clear();
+  body.raw("{\"token\":");
+  body.quoted(token.data(), token.size());
+  body.raw(",\"messages\":[");
+  for (size_t i = 0; i < messages.size(); ++i) {
+    body.raw(i ? ",{\"room\":" : "{\"room\":");
+    body.quoted(messages[i].first.data(), messages[i].first.size());
+    body.raw(",\"message\":");
+    body.quoted(messages[i].second.data(), messages[i].second.size());
+    body.raw("}");
+  }
+  body.raw("]}");
+
+  string response;
+  JsonDocument doc;
+  int status = 0;
+  ResponseStatus result =
+      exchange(server, ENDPOINT_SEND_BATCH, body, response, doc, 0, &status);
+  if (status == HTTP_CODE_NOT_FOUND || status == HTTP_CODE_METHOD_NOT_ALLOWED) {
+    // an older server, every later flush goes one message at a time
+    server.batchUnsupported = true;
+    return RESPONSE_TRANSPORT_ERROR;
+  }
+  return result;
 }
 
-bool MessageJar::user_exists(string username) {
-  auto resp = request("/user/exists", {{"username", username}});
-  if (resp) {
-    if (resp->find("true") != string::npos) {
-      return true;
+ResponseStatus MessageJar::create_room(const string &room_name) {
+  JsonDocument doc;
+  std::lock_guard<std::mutex> lock(callMutex);
+  return call(server, ENDPOINT_ROOMS_CREATE, body, {token, room_name}, doc);
+}
+
+bool MessageJar::user_exists(Server &server, const string &username) {
+  JsonDocument doc;
+  RequestBody body;
+  if (call(server, ENDPOINT_USER_EXISTS, body, {username}, doc) !=
+      RESPONSE_OK) {
+    return false;
+  }
+  if (doc.is<bool>()) {
+    return doc.as<bool>();
+  }
+  for (auto pair : doc.as<JsonObjectConst>()) {
+    if (pair.value().is<bool>()) {
+      return pair.value().as<bool>();
     }
   }
   return false;
 }
 
-string MessageJar::generate_token(string username, string password,
-                                  string name) {
-  auto resp =
-      request("/user/generate",
-              {{"username", username}, {"password", password}, {"name", name}});
-
-  if (resp && check_resp(*resp)) {
-    JsonDocument doc;
-    deserializeJson(doc, resp->c_str());
-    return doc["token"].as<string>();
+string MessageJar::generate_token(Server &server, const string &username,
+                                  const string &password, const string &name) {
+  JsonDocument doc;
+  RequestBody body;
+  if (call(server, ENDPOINT_USER_GENERATE, body, {username, password, name},
+           doc) != RESPONSE_OK) {
+    return "";
   }
-  return "";
+  return doc["token"].as<string>();
 }
 
 void MessageJar::revoke() {
-  auto resp = request("/token/revoke", {{"token", token}});
+  JsonDocument doc;
+  std::lock_guard<std::mutex> lock(callMutex);
+  call(server, ENDPOINT_TOKEN_REVOKE, body, {token}, doc);
 }
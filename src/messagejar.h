@@ -1,23 +1,68 @@
 #ifndef MESSAGEJAR_H
 #define MESSAGEJAR_H
 
+#include "arena.h"
+#include "breaker.h"
+#include "connpool.h"
+#include "endpoints.h"
+#include "requestbody.h"
+#include "response.h"
+
+#include <ArduinoJson.h>
+#include <atomic>
 #include <string>
 #include <memory>
+#include <mutex>
 #include <vector>
-#include <map>
+#include <utility>
 
 using std::shared_ptr;
 using std::string;
 using std::unique_ptr;
 using std::vector;
 
-unique_ptr<string> request(const string &endpoint, const std::map<string, string> &kv);
+#define RESPONSE_BUFFER_KEEP 4096 // response capacity kept between requests
+#define DEFAULT_SERVER_URL "https://messagejar.pythonanywhere.com/api/v1"
+
+class HTTPClient;
+class WiFiClientSecure;
+
+// A Message Jar server, "https://host[:port]/path" of its API, and the
+// connections kept open to it
+class Server
+{
+public:
+    Server(const string &url = DEFAULT_SERVER_URL);
+
+    const string &url() const { return baseUrl; }
+    // The full url of an endpoint, built once with the server
+    const string &url(EndpointId id) const { return endpointUrls[id]; }
+
+    ConnectionPool pool;
+    CircuitBreaker breaker;
+    std::atomic<bool> batchUnsupported{false}; // answered /send/batch with 404
+
+private:
+    string baseUrl;
+    string endpointUrls[ENDPOINT_COUNT];
+};
+
+// Posts `body` to endpoint `id`, `status` gets the HTTP status code when
+// given. A 5xx answer counts as not delivered. `cancel` may end the request
+// from another task.
+bool request(Server &server, EndpointId id, const RequestBody &body, string &response,
+             uint16_t timeout = 0, int *status = nullptr, Cancellation *cancel = nullptr);
+// Parses `body`, answered with HTTP status `code`, into `doc` once and
+// classifies it with classify_response
+ResponseStatus decode_response(bool delivered, int code, const string &body, JsonDocument &doc,
+                               bool needsBody, string *error = nullptr);
 
 class Message
 {
 public:
-    Message(const std::map<string, string> &data);
+    Message(JsonObjectConst data);
     string as_string() const;
+    void append_to(string &out) const;
 
 private:
     string author;
@@ -26,22 +71,49 @@ private:
     string message_id;
 };
 
+// Request and response buffers of one polling task. Each task that polls
+// brings its own, so polls from different tasks never share them.
+struct PollBuffers
+{
+    RequestBody body;
+    string response;
+};
+
+// Safe to call from any task. Polls write only the caller's PollBuffers, the
+// other calls share one request body under callMutex. userMutex in main.cpp
+// only keeps sends in order with the other short calls.
 class MessageJar
 {
 public:
-    MessageJar(string token);
-    bool check();
-    static bool create_user(string username, string password);
+    MessageJar(Server &server, const string &token);
+    ResponseStatus check();
+    static ResponseStatus create_user(Server &server, const string &username,
+                                      const string &password);
     shared_ptr<vector<string>> get_rooms();
-    shared_ptr<vector<Message>> get_messages(string room, int latest = 0);
-    bool send(string room, string content);
-    bool create_room(string room_name);
-    static bool user_exists(string username); 
-    static string generate_token(string username, string password, string name);
+    // `wait` seconds the server may hold the request, `cancel` ends it early
+    ResponseStatus get_messages(const string &room, size_t latest, vector<Message> &out, Arena &arena,
+                                PollBuffers &buffers, unsigned int wait = 0,
+                                Cancellation *cancel = nullptr);
+    bool open_stream(const string &room, size_t latest, WiFiClientSecure &client, HTTPClient &http,
+                     RequestBody &body, bool &unsupported);
+    // `status` gets the HTTP status code when given
+    ResponseStatus send(const string &room, const string &content, int *status = nullptr);
+    // (room, message) pairs in one /send/batch request, in order. The server
+    // takes all of them or, answering with an error, none. batching() turns
+    // false for good when the server has no such endpoint.
+    ResponseStatus send_batch(const vector<std::pair<string, string>> &messages);
+    bool batching() const { return !server.batchUnsupported; }
+    ResponseStatus create_room(const string &room_name);
+    static bool user_exists(Server &server, const string &username);
+    static string generate_token(Server &server, const string &username, const string &password,
+                                 const string &name);
     void revoke();
 
 private:
+    Server &server;
     string token;
+    std::mutex callMutex;
+    RequestBody body; // every call but the polls, under callMutex
 };
 
 #endif // MESSAGEJAR_H
@@ -0,0 +1,145 @@
+#include "metrics.h"
+#include "tasks.h"
+
+#include <ArduinoJson.h>
+#include <esp_heap_caps.h>
+
+Metrics metrics;
+
+static const char *TIMING_NAMES[TIMING_COUNT] = {
+    "dns",   "connect",         "server",        "download",   "request",
+    "parse", "render_terminal", "render_prompt", "render_list"};
+
+static const char *COUNTER_NAMES[COUNTER_COUNT] = {
+    "requests",           "request_errors",  "parse_errors",
+    "bytes_out",          "bytes_in",        "bytes_decoded",
+    "polls",              "polls_empty",     "messages",
+    "arena_overflows",    "glyph_misses",    "power_active_ms",
+    "power_idle_ms",      "power_away_ms",   "power_nap_ms",
+    "charge_mas",         "connects",        "unverified_connects",
+    "connections_reused", "body_spills",     "retries",
+    "breaker_opens",      "breaker_rejects"};
+
+void Histogram::record(uint32_t micros) {
+  ++count;
+  sum += micros;
+  min = std::min(min, micros);
+  max = std::max(max, micros);
+
+  uint8_t bucket = 0;
+  while (bucket < METRICS_BUCKETS - 1 && (micros >> (bucket + 1))) {
+    ++bucket;
+  }
+  ++buckets[bucket];
+}
+
+void Metrics::record(Timing timing, uint32_t micros) {
+  std::lock_guard<std::mutex> lock(mutex);
+  timings[timing].record(micros);
+}
+
+void Metrics::add(Counter counter, uint32_t amount) {
+  std::lock_guard<std::mutex> lock(mutex);
+  counters[counter] += amount;
+}
+
+void Metrics::logTo(SdWriter *sd, const std::string &path) {
+  std::lock_guard<std::mutex> lock(serviceMutex);
+  this->sd = sd;
+  logPath = path;
+  lastLog = millis();
+}
+
+void Metrics::service() {
+  std::unique_lock<std::mutex> servicing(serviceMutex, std::try_to_lock);
+  if (!servicing.owns_lock()) {
+    return; // another task is at it
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint32_t freeHeap = ESP.getFreeHeap();
+    uint32_t largest = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    minFreeHeap = std::min(minFreeHeap, freeHeap);
+    minLargestBlock = std::min(minLargestBlock, largest);
+  }
+
+  while (Serial.available() > 0) {
+    char c = Serial.read();
+    if (c == '\n' || c == '\r') {
+      if (command == "metrics") {
+        dump(Serial);
+      }
+      command.clear();
+    } else if (command.size() < 16) {
+      command += c;
+    }
+  }
+
+  if (sd && millis() - lastLog > METRICS_LOG_INTERVAL) {
+    lastLog = millis();
+    sd->post(logPath, json() + "\n", true);
+  }
+}
+
+void Metrics::dump(Print &out) {
+  out.println(json().c_str());
+}
+
+std::string Metrics::json() {
+  JsonDocument doc;
+
+  // the least each stack had left so far, what a soak sizes them by
+  JsonObject stacks = doc["stack_free"].to<JsonObject>();
+  for (const auto &task : taskInfo()) {
+    stacks[task.name] = task.freeStack;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    doc["uptime_ms"] = millis();
+
+    JsonObject heap = doc["heap"].to<JsonObject>();
+    heap["free"] = ESP.getFreeHeap();
+    heap["largest_block"] =
+        heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    heap["min_free"] = minFreeHeap;
+    heap["min_largest_block"] = minLargestBlock;
+
+    JsonObject counts = doc["counters"].to<JsonObject>();
+    for (int i = 0; i < COUNTER_COUNT; ++i) {
+      counts[COUNTER_NAMES[i]] = counters[i];
+    }
+
+    JsonObject times = doc["timings_us"].to<JsonObject>();
+    for (int i = 0; i < TIMING_COUNT; ++i) {
+      const Histogram &h = timings[i];
+      JsonObject t = times[TIMING_NAMES[i]].to<JsonObject>();
+      t["count"] = h.count;
+      if (!h.count) {
+        continue;
+      }
+      t["min"] = h.min;
+      t["mean"] = (uint32_t)(h.sum / h.count);
+      t["max"] = h.max;
+
+      // bucket i counts samples in [2^i, 2^(i+1)) us, trailing zeros dropped
+      int last = METRICS_BUCKETS - 1;
+      while (last > 0 && !h.buckets[last]) {
+        --last;
+      }
+      JsonArray buckets = t["log2_buckets"].to<JsonArray>();
+      for (int b = 0; b <= last; ++b) {
+        buckets.add(h.buckets[b]);
+      }
+    }
+  }
+
+  std::string out;
+  serializeJson(doc, out);
+  return out;
+}
+
+ScopedTiming::ScopedTiming(Timing timing) : timing(timing), start(micros()) {}
+
+ScopedTiming::~ScopedTiming() { metrics.record(timing, micros() - start); }
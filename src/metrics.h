@@ -0,0 +1,110 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "sdwriter.h"
+
+#include <Arduino.h>
+#include <mutex>
+#include <string>
+
+#define METRICS_BUCKETS 24          // log2 buckets of microseconds, up to ~16 s
+#define METRICS_LOG_PATH "/mjmetrics.log"
+#define METRICS_LOG_INTERVAL 60000  // ms between lines appended to the SD log
+
+enum Timing
+{
+    TIMING_DNS,      // host lookup
+    TIMING_CONNECT,  // TCP connect and TLS handshake
+    TIMING_SERVER,   // request sent until the status line arrived
+    TIMING_DOWNLOAD, // response body
+    TIMING_REQUEST,  // whole request() call
+    TIMING_PARSE,    // JSON decoding of responses
+    TIMING_RENDER_TERMINAL,
+    TIMING_RENDER_PROMPT,
+    TIMING_RENDER_LIST,
+    TIMING_COUNT
+};
+
+enum Counter
+{
+    COUNTER_REQUESTS,
+    COUNTER_REQUEST_ERRORS,
+    COUNTER_PARSE_ERRORS,
+    COUNTER_BYTES_OUT,
+    COUNTER_BYTES_IN,      // body bytes on the wire
+    COUNTER_BYTES_DECODED, // body bytes after decompression
+    COUNTER_POLLS,
+    COUNTER_POLLS_EMPTY,
+    COUNTER_MESSAGES,
+    COUNTER_ARENA_OVERFLOWS,
+    COUNTER_GLYPH_MISSES,  // glyphs read from the SD font
+    COUNTER_POWER_ACTIVE_MS,
+    COUNTER_POWER_IDLE_MS,
+    COUNTER_POWER_AWAY_MS,
+    COUNTER_POWER_NAP_MS,  // of the away time, spent in light sleep
+    COUNTER_CHARGE_MAS,    // approximate charge used, mA * s, from assumed draws
+    COUNTER_CONNECTS,      // full TLS handshakes
+    COUNTER_UNVERIFIED_CONNECTS, // of those, to a server nothing was pinned for
+    COUNTER_CONNECTIONS_REUSED,
+    COUNTER_BODY_SPILLS,   // request bodies too big for the fixed buffer
+    COUNTER_RETRIES,
+    COUNTER_BREAKER_OPENS,
+    COUNTER_BREAKER_REJECTS, // calls failed at once by an open breaker
+    COUNTER_COUNT
+};
+
+struct Histogram
+{
+    uint32_t count = 0;
+    uint64_t sum = 0;
+    uint32_t min = UINT32_MAX;
+    uint32_t max = 0;
+    uint32_t buckets[METRICS_BUCKETS] = {};
+
+    void record(uint32_t micros);
+};
+
+// Process wide registry of timings and counters. Dumped as JSON over serial
+// when "metrics" is sent to the device, and optionally logged to the SD card.
+class Metrics
+{
+public:
+    void record(Timing timing, uint32_t micros);
+    void add(Counter counter, uint32_t amount = 1);
+    void logTo(SdWriter *sd, const std::string &path = METRICS_LOG_PATH);
+
+    // Call often from a running task, answers serial requests and logs.
+    // Safe from several tasks, a call made while another runs returns at once.
+    void service();
+    void dump(Print &out);
+    std::string json();
+
+private:
+    std::mutex mutex;
+    Histogram timings[TIMING_COUNT];
+    uint64_t counters[COUNTER_COUNT] = {};
+    uint32_t minFreeHeap = UINT32_MAX;
+    uint32_t minLargestBlock = UINT32_MAX;
+
+    std::mutex serviceMutex; // the serial command and the log timer
+    SdWriter *sd = nullptr;
+    std::string logPath;
+    unsigned long lastLog = 0;
+    std::string command;
+};
+
+// Records the lifetime of the scope into a timing
+class ScopedTiming
+{
+public:
+    ScopedTiming(Timing timing);
+    ~ScopedTiming();
+
+private:
+    Timing timing;
+    unsigned long start;
+};
+
+extern Metrics metrics;
+
+#endif // METRICS_H
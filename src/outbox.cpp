@@ -0,0 +1,187 @@
+#include "outbox.h"
+
+#include <ArduinoJson.h>
+#include <chrono>
+#include <climits>
+#include <set>
+
+// Calls `entry` with each complete line of `lines` that parses, the torn
+// one a crash may leave at the end is not complete
+template <typename Entry> static void forEachLine(const string &lines, Entry entry) {
+  JsonDocument doc;
+  size_t start = 0;
+  while (start < lines.size()) {
+    size_t end = lines.find('\n', start);
+    if (end == string::npos) {
+      break;
+    }
+    if (!deserializeJson(doc, lines.c_str() + start, end - start)) {
+      entry(doc);
+    }
+    start = end + 1;
+  }
+}
+
+Outbox::Outbox(SdService &sd, const string &dir) : sd(sd), dir(dir) {}
+
+void Outbox::load() {
+  std::lock_guard<std::mutex> lock(mutex);
+  queue.clear();
+
+  string ack = sd.readFile(dir + OUTBOX_ACK_FILE);
+  uint32_t acked = ack.empty() ? 0 : strtoul(ack.c_str(), nullptr, 10);
+
+  // parked before the crash that kept them from being acknowledged
+  std::set<uint32_t> parked;
+  string parkedLines = sd.readFile(dir + OUTBOX_PARKED_FILE);
+  forEachLine(parkedLines, [&](JsonDocument &doc) {
+    parked.insert(doc["seq"].as<uint32_t>());
+  });
+  if (!parked.empty()) {
+    lastSeq = std::max(lastSeq, *parked.rbegin());
+  }
+
+  string journal = sd.readFile(dir + OUTBOX_FILE);
+  forEachLine(journal, [&](JsonDocument &doc) {
+    OutboxEntry entry{doc["seq"].as<uint32_t>(), doc["room"].as<string>(),
+                      doc["message"].as<string>()};
+    lastSeq = std::max(lastSeq, entry.seq);
+    if (entry.seq > acked && !parked.count(entry.seq)) {
+      queue.push_back(entry);
+    }
+  });
+  lastSeq = std::max(lastSeq, acked);
+
+  if (!journal.empty() && journal.back() != '\n') {
+    // a torn last line, never acknowledged to the user as queued. The next
+    // entry starts on a line of its own instead of completing it.
+    sd.appendToFile(dir + OUTBOX_FILE, "\n");
+  }
+}
+
+void Outbox::enqueue(const string &room, const string &message) {
+  std::lock_guard<std::mutex> lock(mutex);
+  OutboxEntry entry{++lastSeq, room, message};
+
+  JsonDocument doc;
+  doc["seq"] = entry.seq;
+  doc["room"] = entry.room;
+  doc["message"] = entry.message;
+  string line;
+  serializeJson(doc, line);
+  line += '\n';
+
+  sd.ensureDirectory(dir);
+  sd.appendToFile(dir + OUTBOX_FILE, line);
+  queue.push_back(entry);
+  if (!waiting) {
+    waiting = true;
+    firstQueued = millis();
+  }
+  queued.notify_one();
+}
+
+size_t Outbox::pending() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return queue.size();
+}
+
+bool Outbox::stalled() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return failing;
+}
+
+unsigned long Outbox::dueIn() {
+  if (queue.empty()) {
+    return ULONG_MAX;
+  }
+  unsigned long now = millis();
+  if (failing) {
+    unsigned long waited = now - lastFailure;
+    return waited < OUTBOX_RETRY ? OUTBOX_RETRY - waited : 0;
+  }
+  if (waiting) {
+    unsigned long waited = now - firstQueued;
+    return waited < OUTBOX_COALESCE ? OUTBOX_COALESCE - waited : 0;
+  }
+  return 0;
+}
+
+bool Outbox::waitForFlush(unsigned long limit) {
+  std::unique_lock<std::mutex> lock(mutex);
+  unsigned long wait = std::min(dueIn(), limit);
+  if (wait) {
+    // an enqueue cuts the wait short, to start its own
+    queued.wait_for(lock, std::chrono::milliseconds(wait));
+  }
+  return dueIn() == 0;
+}
+
+size_t Outbox::flush(MessageJar *user, std::mutex &userMutex) {
+  std::unique_lock<std::mutex> flushing(flushMutex, std::try_to_lock);
+  if (!flushing.owns_lock()) {
+    return pending(); // another task is already sending
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (failing && millis() - lastFailure < OUTBOX_RETRY) {
+      return queue.size();
+    }
+    failing = false;
+    // what is queued from here on waits for a flush of its own
+    waiting = false;
+  }
+
+  while (true) {
+    vector<OutboxEntry> batch;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      for (size_t i = 0; i < queue.size() && i < OUTBOX_BATCH; ++i) {
+        batch.push_back(queue[i]);
+      }
+    }
+    if (batch.empty()) {
+      break;
+    }
+
+    if (!deliverBatch(
+            *user, userMutex, batch,
+            [this](size_t count) { acknowledge(count); },
+            [this](const OutboxEntry &entry) { park(entry); })) {
+      std::lock_guard<std::mutex> lock(mutex);
+      failing = true;
+      lastFailure = millis();
+      break;
+    }
+  }
+
+  return pending();
+}
+
+void Outbox::park(const OutboxEntry &entry) {
+  JsonDocument doc;
+  doc["seq"] = entry.seq;
+  doc["room"] = entry.room;
+  doc["message"] = entry.message;
+  string line;
+  serializeJson(doc, line);
+  line += '\n';
+  sd.appendToFile(dir + OUTBOX_PARKED_FILE, line);
+}
+
+void Outbox::acknowledge(size_t count) {
+  std::lock_guard<std::mutex> lock(mutex);
+  uint32_t seq = 0;
+  for (size_t i = 0; i < count && !queue.empty(); ++i) {
+    seq = queue.front().seq;
+    queue.pop_front();
+  }
+  // written before the journal goes, a crash in between must not bring
+  // back what was delivered. Kept after that, so sequence numbers never
+  // start over and meet the parked ones again.
+  sd.writeFile(dir + OUTBOX_ACK_FILE, std::to_string(seq));
+  if (queue.empty()) {
+    // everything delivered, start the journal over
+    sd.deleteFile(dir + OUTBOX_FILE);
+  }
+}
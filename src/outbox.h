@@ -0,0 +1,80 @@
+#ifndef OUTBOX_H
+#define OUTBOX_H
+
+#include "SdService.h"
+#include "history.h"
+#include "messagejar.h"
+#include "outboxbatch.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+
+using std::string;
+
+#define OUTBOX_FILE "/outbox.log" // in the history directory
+#define OUTBOX_ACK_FILE "/outbox.ack"
+#define OUTBOX_PARKED_FILE "/outbox.parked" // messages the server rejected
+#define OUTBOX_RETRY 5000 // ms before sending again after a failed attempt
+#define OUTBOX_BATCH 20   // queued messages sent in one request at most
+#define OUTBOX_COALESCE 150 // ms the sender waits after a first message for more to join it
+
+// Messages waiting to be sent, journaled to the SD card so they survive a
+// lost connection or a reboot. The journal holds one JSON line per message
+// and the ack file the sequence number of the last one delivered.
+class Outbox
+{
+public:
+    Outbox(SdService &sd, const string &dir = HISTORY_DIR);
+
+    void load();
+    // Journals the message and wakes the sender, which sends it
+    // OUTBOX_COALESCE ms later with whatever was queued in between
+    void enqueue(const string &room, const string &message);
+    size_t pending();
+    // True after a flush that failed, until one goes through
+    bool stalled();
+
+    // Blocks the sending task until a flush is due or `limit` ms pass, true
+    // when one is. A flush is due OUTBOX_COALESCE ms after the first message
+    // queued since the previous one, OUTBOX_RETRY ms after a failed one, and
+    // at once for messages loaded from the journal.
+    bool waitForFlush(unsigned long limit);
+
+    // Sends in order until a message fails to go through, returns how many
+    // are left. A message the server rejects is moved to the parked file,
+    // resending it would only block the ones behind it. An error that is not
+    // about the message, such as a bad token, stops the flush like a lost
+    // connection. Does nothing for OUTBOX_RETRY ms after a
+    // failed attempt so an outage costs one request, not one per call.
+    // Everything queued by then, including messages sent while another flush
+    // was running, goes out in batches of OUTBOX_BATCH when the server takes
+    // them, one by one over the kept connection otherwise. A batch the
+    // server rejects is sent on one by one, so a bad message costs a single
+    // extra request.
+    size_t flush(MessageJar *user, std::mutex &userMutex);
+
+private:
+    // Drops the first `count` entries and journals how far delivery got
+    void acknowledge(size_t count);
+    // Keeps a rejected message on the SD card, out of the queue
+    void park(const OutboxEntry &entry);
+    // ms until a flush is due, 0 when it is, ULONG_MAX with nothing queued.
+    // Called with `mutex` held.
+    unsigned long dueIn();
+
+    SdService &sd;
+    string dir;
+    std::mutex mutex;      // queue, journal and the timing of flushes
+    std::mutex flushMutex; // one sender at a time
+    std::condition_variable queued;
+    std::deque<OutboxEntry> queue;
+    uint32_t lastSeq = 0;
+    unsigned long firstQueued = 0; // of the messages queued since the last flush
+    bool waiting = false;          // for OUTBOX_COALESCE to pass
+    unsigned long lastFailure = 0;
+    bool failing = false;
+};
+
+#endif // OUTBOX_H
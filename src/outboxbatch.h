@@ -0,0 +1,86 @@
+#ifndef OUTBOXBATCH_H
+#define OUTBOXBATCH_H
+
+#include "response.h"
+
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+struct OutboxEntry
+{
+    uint32_t seq;
+    string room;
+    string message;
+};
+
+// Whether an error answer to a send is about the message itself. A bad
+// token, a timeout or rate limiting says nothing about the message, it is
+// kept and sent again later.
+inline bool outboxRejected(int code)
+{
+    return code != 401 && code != 403 && code != 408 && code != 429;
+}
+
+// Sends `batch`, the front of the outbox, the way Outbox::flush does: as one
+// request while `user` takes batches, otherwise, or when the server rejected
+// the batch, one message at a time. Calls `acknowledge` with how many of the
+// front entries went through and `park` with each one the server rejects,
+// in queue order. False when a failure that is not about the messages
+// stopped it. `user` is a MessageJar on the device.
+template <typename User, typename Acknowledge, typename Park>
+bool deliverBatch(User &user, std::mutex &userMutex, const vector<OutboxEntry> &batch,
+                  Acknowledge acknowledge, Park park)
+{
+    if (batch.size() > 1 && user.batching())
+    {
+        vector<std::pair<string, string>> messages;
+        for (const auto &entry : batch)
+        {
+            messages.emplace_back(entry.room, entry.message);
+        }
+        ResponseStatus status;
+        {
+            std::lock_guard<std::mutex> lock(userMutex);
+            status = user.send_batch(messages);
+        }
+        if (status == RESPONSE_OK)
+        {
+            acknowledge(batch.size());
+            return true;
+        }
+        if (status == RESPONSE_TRANSPORT_ERROR && user.batching())
+        {
+            return false;
+        }
+        // not offered, or one of them was rejected: the rest of this batch
+        // goes one at a time, which finds the one
+    }
+
+    for (const auto &entry : batch)
+    {
+        ResponseStatus status;
+        int code = 0;
+        {
+            std::lock_guard<std::mutex> lock(userMutex);
+            status = user.send(entry.room, entry.message, &code);
+        }
+        if (status == RESPONSE_API_ERROR && outboxRejected(code))
+        {
+            park(entry);
+        }
+        else if (status != RESPONSE_OK)
+        {
+            return false;
+        }
+        acknowledge(1);
+    }
+    return true;
+}
+
+#endif // OUTBOXBATCH_H
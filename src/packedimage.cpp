@@ -0,0 +1,70 @@
+#include "packedimage.h"
+
+#include <M5Cardputer.h>
+#include <string.h>
+
+#define IMAGE_HEADER_SIZE 10
+
+bool PackedImage::open(const uint8_t *data, size_t size) {
+  if (size < IMAGE_HEADER_SIZE || memcmp(data, "MJI1", 4)) {
+    return false;
+  }
+  imageWidth = data[4] | (data[5] << 8);
+  imageHeight = data[6] | (data[7] << 8);
+  colors = data[8] + 1;
+  palette = data + IMAGE_HEADER_SIZE;
+  next = palette + colors * 2;
+  end = data + size;
+  left = 0;
+  return next <= end && imageWidth <= IMAGE_MAX_WIDTH;
+}
+
+bool PackedImage::decode(uint16_t *out, size_t count) {
+  while (count) {
+    if (!left) {
+      if (end - next < 2 || next[0] >= colors) {
+        return false;
+      }
+      const uint8_t *entry = palette + next[0] * 2;
+      color = entry[0] | (entry[1] << 8);
+      left = next[1] + 1;
+      next += 2;
+    }
+    size_t n = left < count ? left : count;
+    for (size_t i = 0; i < n; ++i) {
+      out[i] = color;
+    }
+    out += n;
+    count -= n;
+    left -= n;
+  }
+  return true;
+}
+
+bool drawPackedImage(const uint8_t *data, size_t size, int32_t x, int32_t y) {
+  // internal RAM, so the DMA can read it
+  static uint16_t chunks[2][IMAGE_MAX_WIDTH * IMAGE_CHUNK_ROWS];
+
+  PackedImage image;
+  if (!image.open(data, size)) {
+    return false;
+  }
+
+  bool ok = true;
+  int which = 0;
+  M5Cardputer.Display.startWrite();
+  for (uint16_t row = 0; ok && row < image.height(); row += IMAGE_CHUNK_ROWS) {
+    uint16_t rows = image.height() - row < IMAGE_CHUNK_ROWS
+                        ? image.height() - row
+                        : IMAGE_CHUNK_ROWS;
+    // the transfer before last used this buffer, pushImageDMA waited for it
+    ok = image.decode(chunks[which], (size_t)image.width() * rows);
+    if (ok) {
+      M5Cardputer.Display.pushImageDMA(x, y + row, image.width(), rows,
+                                       chunks[which]);
+    }
+    which ^= 1;
+  }
+  M5Cardputer.Display.endWrite();
+  return ok;
+}
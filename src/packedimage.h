@@ -0,0 +1,45 @@
+#ifndef PACKEDIMAGE_H
+#define PACKEDIMAGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define IMAGE_MAX_WIDTH 240 // pixels, the screen
+#define IMAGE_CHUNK_ROWS 8  // rows decoded per DMA transfer, two chunks are buffered
+#define LOGO_PATH "/mjlogo.bin" // replaces the boot logo when on the SD card
+
+// Reads an RGB565 image packed by tools/pack_image.py a few pixels at a
+// time, so it never has to be unpacked whole.
+//
+// Layout, little endian: "MJI1", width (u16), height (u16), palette size
+// less one (u8), a reserved byte, the palette as RGB565 (u16 each), then
+// runs in pixel order as a palette index (u8) and the run length less one
+// (u8).
+class PackedImage
+{
+public:
+    // False when `data` is not a packed image
+    bool open(const uint8_t *data, size_t size);
+    uint16_t width() const { return imageWidth; }
+    uint16_t height() const { return imageHeight; }
+
+    // Writes the next `count` pixels to `out`, false when the runs end or
+    // point past the palette first
+    bool decode(uint16_t *out, size_t count);
+
+private:
+    const uint8_t *palette = nullptr;
+    const uint8_t *next = nullptr; // next run
+    const uint8_t *end = nullptr;
+    uint16_t imageWidth = 0;
+    uint16_t imageHeight = 0;
+    uint16_t colors = 0;
+    uint16_t color = 0;    // of the run being read
+    uint16_t left = 0;     // pixels of it not yet written
+};
+
+// Draws a packed image with its top left corner at (x, y), decoding each
+// chunk of rows while the one before it goes out by DMA
+bool drawPackedImage(const uint8_t *data, size_t size, int32_t x, int32_t y);
+
+#endif // PACKEDIMAGE_H
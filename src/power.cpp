@@ -0,0 +1,127 @@
+#include "power.h"
+#include "metrics.h"
+
+#include <M5Cardputer.h>
+#include <WiFi.h>
+#include <driver/gpio.h>
+#include <esp_sleep.h>
+
+#include <algorithm>
+
+PowerManager power;
+
+// The keyboard's 74HC138 drives exactly one row low, picked by these pins, so
+// only that row's keys can pull a column input low during a nap
+static const uint8_t ROW_SELECT[] = {8, 9, 11};
+static const gpio_num_t COLUMNS[] = {GPIO_NUM_13, GPIO_NUM_15, GPIO_NUM_3,
+                                     GPIO_NUM_4,  GPIO_NUM_5,  GPIO_NUM_6,
+                                     GPIO_NUM_7};
+
+static const uint32_t POLL_INTERVAL[POWER_MODES] = {1000, 5000, 30000};
+static const uint32_t CPU_MHZ[POWER_MODES] = {240, 80, 80};
+static const uint32_t CURRENT_MA[POWER_MODES] = {
+    POWER_MA_ACTIVE, POWER_MA_IDLE, POWER_MA_AWAY};
+static const Counter TIME_COUNTER[POWER_MODES] = {
+    COUNTER_POWER_ACTIVE_MS, COUNTER_POWER_IDLE_MS, COUNTER_POWER_AWAY_MS};
+
+void PowerManager::begin() {
+  brightness = M5.Lcd.getBrightness();
+  lastInput = lastService = millis();
+  apply(POWER_ACTIVE);
+}
+
+void PowerManager::activity() {
+  lastInput = millis();
+  if (current != POWER_ACTIVE) {
+    service();
+  }
+}
+
+void PowerManager::service() {
+  unsigned long now = millis();
+
+  // duty cycle: time per mode and a rough guess at the charge it costs
+  uint32_t elapsed = now - lastService;
+  lastService = now;
+  metrics.add(TIME_COUNTER[current], elapsed);
+  spend(elapsed, CURRENT_MA[current]);
+
+  unsigned long quiet = now - lastInput;
+  PowerMode wanted = quiet >= POWER_AWAY_AFTER   ? POWER_AWAY
+                     : quiet >= POWER_IDLE_AFTER ? POWER_IDLE
+                                                 : POWER_ACTIVE;
+  if (wanted != current) {
+    apply(wanted);
+  }
+  if (current == POWER_AWAY) {
+    nap();
+  }
+}
+
+void PowerManager::spend(uint32_t ms, uint32_t ma) {
+  // called every few ms, dividing each share would round most of it away
+  uint64_t reported = charge / 1000;
+  charge += (uint64_t)ms * ma;
+  metrics.add(COUNTER_CHARGE_MAS, charge / 1000 - reported);
+}
+
+void PowerManager::nap() {
+  unsigned long until = idleUntil;
+  unsigned long now = millis();
+  if (!until || (long)(until - now) < POWER_NAP_MIN) {
+    return;
+  }
+  uint32_t ms = std::min<unsigned long>(until - now, POWER_NAP_MAX);
+
+  // arm the first row, every select pin low
+  for (uint8_t pin : ROW_SELECT) {
+    digitalWrite(pin, LOW);
+  }
+  for (gpio_num_t pin : COLUMNS) {
+    gpio_wakeup_enable(pin, GPIO_INTR_LOW_LEVEL);
+  }
+  gpio_wakeup_enable(GPIO_NUM_0, GPIO_INTR_LOW_LEVEL);
+  esp_sleep_enable_gpio_wakeup();
+  esp_sleep_enable_timer_wakeup((uint64_t)ms * 1000);
+
+  esp_light_sleep_start();
+
+  for (gpio_num_t pin : COLUMNS) {
+    gpio_wakeup_disable(pin);
+  }
+  gpio_wakeup_disable(GPIO_NUM_0);
+  esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_ALL);
+
+  // millis() kept counting, the nap is taken out of the away time
+  uint32_t slept = millis() - now;
+  metrics.add(COUNTER_POWER_NAP_MS, slept);
+  spend(slept, POWER_MA_NAP);
+  lastService += slept;
+
+  if (esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_GPIO) {
+    activity();
+  }
+}
+
+uint32_t PowerManager::pollInterval() const { return POLL_INTERVAL[current]; }
+
+void PowerManager::apply(PowerMode mode) {
+  current = mode;
+
+  switch (mode) {
+  case POWER_ACTIVE:
+    M5.Lcd.setBrightness(brightness);
+    WiFi.setSleep(WIFI_PS_NONE);
+    break;
+  case POWER_IDLE:
+    M5.Lcd.setBrightness(brightness / 4);
+    WiFi.setSleep(WIFI_PS_MIN_MODEM);
+    break;
+  default:
+    M5.Lcd.setBrightness(brightness / 16);
+    WiFi.setSleep(WIFI_PS_MAX_MODEM);
+    break;
+  }
+
+  setCpuFrequencyMhz(CPU_MHZ[mode]);
+}
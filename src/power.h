@@ -0,0 +1,64 @@
+#ifndef POWER_H
+#define POWER_H
+
+#include <atomic>
+#include <stdint.h>
+
+#define POWER_IDLE_AFTER 30000  // ms without a keypress before going idle
+#define POWER_AWAY_AFTER 300000 // ms without a keypress before going away
+
+// Assumed draw of the whole device in each mode, not measured on a Cardputer.
+// They only feed the approximate charge_mas metric.
+#define POWER_MA_ACTIVE 150
+#define POWER_MA_IDLE 60
+#define POWER_MA_AWAY 25
+#define POWER_MA_NAP 5
+
+#define POWER_NAP_MIN 200  // ms, shorter idle spells are not worth a light sleep
+#define POWER_NAP_MAX 2000 // ms, longest nap, keys off the armed row wait this long
+
+enum PowerMode
+{
+    POWER_ACTIVE, // full speed, backlight on, radio always listening
+    POWER_IDLE,   // dimmed, 80 MHz, modem sleep, slower polling
+    POWER_AWAY,   // backlight nearly off, deepest modem sleep, rare polling
+    POWER_MODES
+};
+
+// Picks a power mode from the time since the last keypress and applies it to
+// the backlight, CPU clock and WiFi power save. In away mode the chip light
+// sleeps while the network has nothing to do, waking on a timer, the G0
+// button or a key of the one keyboard row that can be armed.
+class PowerManager
+{
+public:
+    void begin();
+    // A key was pressed, back to active
+    void activity();
+    // Moves to the mode the idle time calls for and accounts the time spent.
+    // Called from the UI loop, in away mode it may nap there.
+    void service();
+    // The network has nothing to do until `until` (millis), 0 once it does
+    void networkIdle(unsigned long until) { idleUntil = until; }
+
+    PowerMode mode() const { return current; }
+    // ms between polls in the current mode
+    uint32_t pollInterval() const;
+
+private:
+    void apply(PowerMode mode);
+    void nap();
+    // Accounts `ms` at `ma`
+    void spend(uint32_t ms, uint32_t ma);
+
+    std::atomic<PowerMode> current{POWER_ACTIVE};
+    std::atomic<unsigned long> idleUntil{0};
+    unsigned long lastInput = 0;
+    unsigned long lastService = 0;
+    uint64_t charge = 0;      // mA * ms, reported in mA * s
+    uint8_t brightness = 128; // active backlight, read at begin
+};
+
+extern PowerManager power;
+
+#endif // POWER_H
@@ -0,0 +1,113 @@
+#include "profile.h"
+
+#include <ctype.h>
+
+static const char *const PROFILE_KEYS[] = {
+    "server",           "token",  "transport", "poll_interval",
+    "cert_fingerprint", "ca_cert"};
+
+static string setting(JsonVariantConst settings, const char *key,
+                      const string &fallback) {
+  JsonVariantConst value = settings[key];
+  return value.is<const char *>() ? value.as<string>() : fallback;
+}
+
+vector<string> profileNames(JsonDocument &config) {
+  vector<string> names;
+  for (JsonPair pair : config["profiles"].as<JsonObject>()) {
+    names.push_back(pair.key().c_str());
+  }
+  if (names.empty()) {
+    names.push_back(PROFILE_DEFAULT);
+  }
+  return names;
+}
+
+string currentProfile(JsonDocument &config) {
+  vector<string> names = profileNames(config);
+  string selected =
+      config["profile"].is<const char *>() ? config["profile"].as<string>() : "";
+  for (const auto &name : names) {
+    if (name == selected) {
+      return name;
+    }
+  }
+  return names.front();
+}
+
+JsonVariant profileSettings(JsonDocument &config, const string &name) {
+  if (!config["profiles"].is<JsonObject>()) {
+    return config.as<JsonVariant>();
+  }
+  JsonObject profiles = config["profiles"].as<JsonObject>();
+  if (!profiles[name].is<JsonObject>()) {
+    profiles[name].to<JsonObject>();
+  }
+  return profiles[name];
+}
+
+void migrateProfiles(JsonDocument &config) {
+  if (config["profiles"].is<JsonObject>()) {
+    return;
+  }
+  JsonObject profile =
+      config["profiles"].to<JsonObject>()[PROFILE_DEFAULT].to<JsonObject>();
+  for (const char *key : PROFILE_KEYS) {
+    if (!config[key].isNull()) {
+      profile[key] = config[key];
+      config.remove(key);
+    }
+  }
+  config["profile"] = PROFILE_DEFAULT;
+}
+
+string profileDirectory(const string &name) {
+  if (name == PROFILE_DEFAULT) {
+    return HISTORY_DIR;
+  }
+  // SD.mkdir makes one level only, so a sibling of HISTORY_DIR
+  string dir = HISTORY_DIR "-";
+  bool replaced = false;
+  uint32_t hash = 2166136261u;
+  for (char c : name) {
+    hash = (hash ^ (unsigned char)c) * 16777619u;
+    // FAT ignores case, so "Work" and "work" would share a folder too
+    bool kept = islower((unsigned char)c) || isdigit((unsigned char)c) || c == '-';
+    dir += kept ? c : '_';
+    replaced = replaced || !kept;
+  }
+  if (replaced) {
+    // "a b" and "a_b" both read "a_b", the hash of the name tells them apart
+    char suffix[10];
+    snprintf(suffix, sizeof(suffix), "-%08x", (unsigned)hash);
+    dir += suffix;
+  }
+  return dir;
+}
+
+Account::Account(SdService &sd, const string &name, JsonVariantConst settings)
+    : name(name), server(setting(settings, "server", DEFAULT_SERVER_URL)),
+      history(sd, profileDirectory(name)), search(sd, history),
+      outbox(sd, profileDirectory(name)), input(sd, profileDirectory(name)),
+      transport(transportFromName(setting(settings, "transport", "sse"))),
+      pollInterval(settings["poll_interval"].is<uint32_t>()
+                       ? settings["poll_interval"].as<uint32_t>()
+                       : TICKS) {
+  history.setIndex(&search);
+
+  // the bundled CA is the default server's, other servers pin their own.
+  // Without a pinned CA or fingerprint the server is not verified.
+  bool bundled = server.url() == DEFAULT_SERVER_URL;
+  string caPath = setting(settings, "ca_cert", bundled ? TLS_CA_PATH : "");
+  string caCert = caPath.empty() ? "" : sd.readFile(caPath);
+  server.pool.setPins(caCert, setting(settings, "cert_fingerprint", ""));
+  // a CA the profile names must be used, not quietly skipped
+  if (caCert.empty() && settings["ca_cert"].is<const char *>()) {
+    server.pool.refuse("Can't read " + caPath + "!");
+  }
+}
+
+void Account::load() {
+  outbox.load();
+  input.load();
+}
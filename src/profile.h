@@ -0,0 +1,67 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "SdService.h"
+#include "history.h"
+#include "inputstore.h"
+#include "messagejar.h"
+#include "outbox.h"
+#include "roomcache.h"
+#include "search.h"
+#include "transport.h"
+
+#include <ArduinoJson.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+#define PROFILE_DEFAULT "default" // the one profile of a config without "profiles"
+
+// Profiles live in the config as "profiles": {name: settings} with the
+// selected one in "profile". Settings are "server" (API url), "token",
+// "transport", "poll_interval" (ms), "cert_fingerprint" and "ca_cert" (path
+// of a PEM on the SD card). A config without "profiles" keeps the settings
+// of PROFILE_DEFAULT at the top level, as before there were profiles.
+
+vector<string> profileNames(JsonDocument &config);
+// The selected profile, the first one when none or an unknown one is set
+string currentProfile(JsonDocument &config);
+// Settings of `name`, writes to it end up in `config`
+JsonVariant profileSettings(JsonDocument &config, const string &name);
+// Moves top level settings into profiles.default so others can be added
+void migrateProfiles(JsonDocument &config);
+// Where a profile keeps history, drafts and its outbox. The default profile
+// keeps HISTORY_DIR so existing caches stay valid. Names that are not all
+// lowercase letters, digits and '-' get a hash suffix, so two profiles never
+// share a folder.
+string profileDirectory(const string &name);
+
+// Everything that belongs to one account on one server. Switching profiles
+// swaps which Account is in use, the others stay loaded so switching back
+// needs no login or SD reads.
+class Account
+{
+public:
+    Account(SdService &sd, const string &name, JsonVariantConst settings);
+
+    // Reads the outbox and drafts back from the SD card
+    void load();
+
+    const string name;
+    Server server;
+    unique_ptr<MessageJar> user;
+    History history;
+    SearchIndex search;
+    Outbox outbox;
+    InputStore input;
+    RoomCache cache;
+    std::atomic<TransportMode> transport; // lowered when the server lacks a mode
+    uint32_t pollInterval;
+};
+
+#endif // PROFILE_H
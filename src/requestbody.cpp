@@ -0,0 +1,100 @@
+#include "requestbody.h"
+#include "metrics.h"
+
+#include <stdio.h>
+
+void RequestBody::build(const BodyFields &fields,
+                        std::initializer_list<BodyValue> values) {
+  clear();
+  raw("{");
+  size_t i = 0;
+  for (const BodyValue &value : values) {
+    if (i == fields.count) {
+      break;
+    }
+    if (i) {
+      raw(",");
+    }
+    quoted(fields.names[i], strlen(fields.names[i]));
+    raw(":");
+    if (value.text) {
+      quoted(value.text, value.length);
+    } else {
+      number(value.number);
+    }
+    ++i;
+  }
+  raw("}");
+}
+
+void RequestBody::clear() {
+  length = 0;
+  if (spilled) {
+    // rare, give the memory back rather than keep it for the next one
+    string().swap(spill);
+    spilled = false;
+  }
+}
+
+void RequestBody::raw(const char *text, size_t count) {
+  if (!spilled && length + count > sizeof(buffer)) {
+    metrics.add(COUNTER_BODY_SPILLS);
+    spill.reserve((length + count) * 2);
+    spill.assign(buffer, length);
+    spilled = true;
+  }
+  if (!spilled) {
+    memcpy(buffer + length, text, count);
+  } else {
+    spill.append(text, count);
+  }
+  length += count;
+}
+
+void RequestBody::quoted(const char *text, size_t count) {
+  raw("\"");
+  size_t start = 0;
+  for (size_t i = 0; i < count; ++i) {
+    unsigned char c = text[i];
+    if (c >= 0x20 && c != '"' && c != '\\') {
+      continue; // UTF-8 goes through as is
+    }
+    raw(text + start, i - start);
+    start = i + 1;
+
+    char escape[8];
+    switch (c) {
+    case '"':
+      raw("\\\"");
+      break;
+    case '\\':
+      raw("\\\\");
+      break;
+    case '\n':
+      raw("\\n");
+      break;
+    case '\r':
+      raw("\\r");
+      break;
+    case '\t':
+      raw("\\t");
+      break;
+    default:
+      snprintf(escape, sizeof(escape), "\\u%04x", c);
+      raw(escape);
+      break;
+    }
+  }
+  raw(text + start, count - start);
+  raw("\"");
+}
+
+void RequestBody::number(uint32_t value) {
+  char digits[12];
+  int count = snprintf(digits, sizeof(digits), "%u", (unsigned)value);
+  raw(digits, count);
+}
+
+const uint8_t *RequestBody::data() const {
+  return (const uint8_t *)(spilled ? spill.data() : buffer);
+}
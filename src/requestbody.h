@@ -0,0 +1,67 @@
+#ifndef REQUESTBODY_H
+#define REQUESTBODY_H
+
+#include <initializer_list>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+
+using std::string;
+
+#define REQUEST_BODY_SIZE 512 // bytes a body may take before it spills to the heap
+
+// Names of the fields of an endpoint's request body, in the order their
+// values are passed. Defined once per endpoint as a static array.
+struct BodyFields
+{
+    const char *const *names;
+    size_t count;
+};
+
+template <size_t N>
+constexpr BodyFields bodyFields(const char *const (&names)[N])
+{
+    return BodyFields{names, N};
+}
+
+// A field value, pointing into the caller's string, or a number
+struct BodyValue
+{
+    BodyValue(const string &text) : text(text.data()), length(text.size()) {}
+    BodyValue(const char *text) : text(text), length(strlen(text)) {}
+    BodyValue(uint32_t number) : number(number) {}
+
+    const char *text = nullptr; // null for a number
+    size_t length = 0;
+    uint32_t number = 0;
+};
+
+// Writes a flat JSON object straight into a fixed buffer that is reused for
+// every request. A body that does not fit, a long message or a batch, moves
+// to the heap for that one request.
+class RequestBody
+{
+public:
+    // {"name": value, ...} with the names of `fields` and `values` in order.
+    // Missing values are left out, extra ones ignored.
+    void build(const BodyFields &fields, std::initializer_list<BodyValue> values);
+
+    // Pieces for bodies that are more than one flat object
+    void clear();
+    void raw(const char *text, size_t length);
+    void raw(const char *text) { raw(text, strlen(text)); }
+    void quoted(const char *text, size_t length); // as a JSON string
+    void number(uint32_t value);
+
+    const uint8_t *data() const;
+    size_t size() const { return length; }
+
+private:
+    char buffer[REQUEST_BODY_SIZE];
+    size_t length = 0;
+    string spill; // holds the whole body once it outgrew the buffer
+    bool spilled = false;
+};
+
+#endif // REQUESTBODY_H
@@ -0,0 +1,34 @@
+#ifndef RESPONSE_H
+#define RESPONSE_H
+
+enum ResponseStatus
+{
+    RESPONSE_OK,
+    RESPONSE_API_ERROR,       // the server answered with an {"e": ...} object
+    RESPONSE_TRANSPORT_ERROR, // no answer, or one that could not be parsed
+};
+
+// What an answer with HTTP status `code` amounts to. `parsed` when its body
+// is JSON, `apiError` when that JSON holds an "e" key. Only a 2xx answer is
+// success, any other is an API error even without an {"e": ...} body.
+// Without `needsBody` an unparseable 2xx body counts as success, as some
+// endpoints send none.
+inline ResponseStatus classify_response(bool delivered, int code, bool parsed, bool apiError,
+                                        bool needsBody)
+{
+    if (!delivered)
+    {
+        return RESPONSE_TRANSPORT_ERROR;
+    }
+    if (apiError || code < 200 || code >= 300)
+    {
+        return RESPONSE_API_ERROR;
+    }
+    if (!parsed && needsBody)
+    {
+        return RESPONSE_TRANSPORT_ERROR;
+    }
+    return RESPONSE_OK;
+}
+
+#endif // RESPONSE_H
@@ -0,0 +1,76 @@
+#include "roomcache.h"
+
+#include <algorithm>
+
+RoomCache::RoomCache(size_t budget) : budget(budget) {}
+
+RoomSnapshot RoomCache::snapshot(const vector<Message> &messages,
+                                 size_t latest) {
+  RoomSnapshot snap;
+  snap.latest = latest;
+
+  size_t first = messages.size() > PREFETCH_MESSAGES
+                     ? messages.size() - PREFETCH_MESSAGES
+                     : 0;
+  for (size_t i = first; i < messages.size(); ++i) {
+    messages[i].append_to(snap.text);
+  }
+  return snap;
+}
+
+bool RoomCache::contains(const string &room) {
+  std::lock_guard<std::mutex> lock(mutex);
+  for (const auto &entry : entries) {
+    if (entry.first == room) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void RoomCache::store(const string &room, RoomSnapshot snap) {
+  // a single room never gets the whole budget, drop its oldest lines instead
+  if (snap.text.size() > budget / 2) {
+    size_t cut = snap.text.find('\n', snap.text.size() - budget / 2);
+    snap.text.erase(0, cut == string::npos ? snap.text.size() : cut + 1);
+  }
+
+  std::lock_guard<std::mutex> lock(mutex);
+  for (auto it = entries.begin(); it != entries.end(); ++it) {
+    if (it->first == room) {
+      bytes -= it->second.text.size();
+      entries.erase(it);
+      break;
+    }
+  }
+
+  bytes += snap.text.size();
+  entries.emplace_front(room, std::move(snap));
+  evict();
+}
+
+bool RoomCache::take(const string &room, RoomSnapshot &out) {
+  std::lock_guard<std::mutex> lock(mutex);
+  for (auto it = entries.begin(); it != entries.end(); ++it) {
+    if (it->first == room) {
+      bytes -= it->second.text.size();
+      out = std::move(it->second);
+      entries.erase(it);
+      return true;
+    }
+  }
+  return false;
+}
+
+void RoomCache::clear() {
+  std::lock_guard<std::mutex> lock(mutex);
+  entries.clear();
+  bytes = 0;
+}
+
+void RoomCache::evict() {
+  while (bytes > budget && !entries.empty()) {
+    bytes -= entries.back().second.text.size();
+    entries.pop_back();
+  }
+}
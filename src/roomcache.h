@@ -0,0 +1,45 @@
+#ifndef ROOMCACHE_H
+#define ROOMCACHE_H
+
+#include "messagejar.h"
+
+#include <list>
+#include <mutex>
+#include <string>
+#include <utility>
+
+using std::string;
+
+#define PREFETCH_MESSAGES 30  // most recent messages kept per room
+#define PREFETCH_BUDGET 16384 // bytes of message text across all rooms
+#define PREFETCH_AHEAD 2      // rooms prefetched after the highlighted one
+
+struct RoomSnapshot
+{
+    string text;       // last messages, already formatted for the terminal
+    size_t latest = 0; // messages the server had when the snapshot was taken
+};
+
+// Thread safe LRU of room snapshots, bounded by PREFETCH_BUDGET bytes.
+class RoomCache
+{
+public:
+    RoomCache(size_t budget = PREFETCH_BUDGET);
+
+    static RoomSnapshot snapshot(const vector<Message> &messages, size_t latest);
+
+    bool contains(const string &room);
+    void store(const string &room, RoomSnapshot snap);
+    bool take(const string &room, RoomSnapshot &out);
+    void clear();
+
+private:
+    void evict();
+
+    std::mutex mutex;
+    std::list<std::pair<string, RoomSnapshot>> entries; // front is newest
+    size_t budget;
+    size_t bytes = 0;
+};
+
+#endif // ROOMCACHE_H
@@ -0,0 +1,41 @@
+#include "sdwriter.h"
+#include "tasks.h"
+
+SdWriter::SdWriter(SdService &sd) : sd(sd) {}
+
+void SdWriter::begin() {
+  queue = xQueueCreate(SD_WRITER_QUEUE, sizeof(Job *));
+  if (queue && !startTask(task, "SdWriter", TASK_STACK_SD_WRITER, this,
+                          TASK_PRIORITY_SD, NETWORK_CORE)) {
+    queue = nullptr;
+  }
+}
+
+void SdWriter::post(const std::string &path, const std::string &data,
+                    bool append) {
+  Job *job = new Job{path, data, append};
+  // blocking keeps the order when the card falls behind
+  if (!queue || xQueueSend(queue, &job, portMAX_DELAY) != pdTRUE) {
+    write(*job);
+    delete job;
+  }
+}
+
+void SdWriter::write(const Job &job) {
+  if (job.append) {
+    sd.appendToFile(job.path, job.data);
+  } else {
+    sd.writeFile(job.path, job.data);
+  }
+}
+
+void SdWriter::task(void *self) {
+  SdWriter *writer = (SdWriter *)self;
+  Job *job;
+  while (true) {
+    if (xQueueReceive(writer->queue, &job, portMAX_DELAY) == pdTRUE) {
+      writer->write(*job);
+      delete job;
+    }
+  }
+}
@@ -0,0 +1,42 @@
+#ifndef SDWRITER_H
+#define SDWRITER_H
+
+#include "SdService.h"
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+
+#include <string>
+
+#define SD_WRITER_QUEUE 16 // writes waiting before post() blocks
+
+// Low priority task that writes files in the order they were posted, for
+// writes the caller does not need to see land before it goes on
+class SdWriter
+{
+public:
+    SdWriter(SdService &sd);
+
+    void begin();
+    // Replaces or appends to `path` later. Writes right away when the task
+    // is not running.
+    void post(const std::string &path, const std::string &data, bool append);
+
+private:
+    struct Job
+    {
+        std::string path;
+        std::string data;
+        bool append;
+    };
+
+    static void task(void *self);
+    void write(const Job &job);
+
+    SdService &sd;
+    QueueHandle_t queue = nullptr;
+};
+
+extern SdWriter sdWriter;
+
+#endif // SDWRITER_H
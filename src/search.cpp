@@ -0,0 +1,317 @@
+#include "search.h"
+
+#include <algorithm>
+
+// Calls `f` with the hash of every word of `text`, lowercased. Bytes above
+// 0x7f count as letters so UTF-8 words stay whole.
+template <typename F>
+static void for_each_word(const char *text, size_t length, F f) {
+  uint32_t hash = 2166136261u;
+  size_t size = 0;
+
+  for (size_t i = 0; i <= length; ++i) {
+    unsigned char c = i < length ? text[i] : ' ';
+    if (isalnum(c) || c >= 0x80) {
+      hash = (hash ^ (unsigned char)tolower(c)) * 16777619u;
+      ++size;
+      continue;
+    }
+    if (size >= SEARCH_MIN_WORD) {
+      f(hash);
+    }
+    hash = 2166136261u;
+    size = 0;
+  }
+}
+
+static bool contains_word(const string &line, const string &word) {
+  auto it = std::search(line.begin(), line.end(), word.begin(), word.end(),
+                        [](char a, char b) {
+                          return tolower((unsigned char)a) ==
+                                 tolower((unsigned char)b);
+                        });
+  return it != line.end();
+}
+
+SearchIndex::SearchIndex(SdService &sd, History &history)
+    : sd(sd), history(history) {}
+
+void SearchIndex::add(const string &room, const string &text, size_t offset) {
+  std::lock_guard<std::mutex> lock(mutex);
+  // anything skipped before is picked up by the next search instead
+  if (covered(room) == offset) {
+    addLocked(room, text, offset);
+  }
+}
+
+void SearchIndex::addLocked(const string &room, const string &text,
+                            size_t offset) {
+  string records;
+  size_t start = 0;
+  while (start < text.size()) {
+    size_t end = text.find('\n', start);
+    if (end == string::npos) {
+      break; // partial line, indexed once it is complete
+    }
+
+    vector<uint32_t> hashes;
+    for_each_word(text.c_str() + start, end - start,
+                  [&](uint32_t hash) { hashes.push_back(hash); });
+    std::sort(hashes.begin(), hashes.end());
+    hashes.erase(std::unique(hashes.begin(), hashes.end()), hashes.end());
+
+    for (uint32_t hash : hashes) {
+      Posting posting{hash, (uint32_t)(offset + start)};
+      records.append((const char *)&posting, sizeof(posting));
+    }
+    start = end + 1;
+  }
+
+  if (!records.empty()) {
+    sd.appendToFile(history.path(room, ".ixt"), records);
+  }
+  sd.writeFile(history.path(room, ".ixc"), std::to_string(offset + start));
+
+  if (sd.fileSize(history.path(room, ".ixt")) >=
+      SEARCH_MERGE_RECORDS * sizeof(Posting)) {
+    merge(room);
+  }
+}
+
+size_t SearchIndex::covered(const string &room) {
+  string data = sd.readFile(history.path(room, ".ixc"));
+  return data.empty() ? 0 : strtoul(data.c_str(), nullptr, 10);
+}
+
+bool SearchIndex::catchUp(const string &room, size_t maxBytes) {
+  std::unique_lock<std::mutex> lock(mutex, std::try_to_lock);
+  if (!lock.owns_lock() || !history.available()) {
+    return false;
+  }
+  return indexLog(room, maxBytes, nullptr);
+}
+
+bool SearchIndex::indexLog(
+    const string &room, size_t maxBytes,
+    const std::function<void(size_t, size_t)> &progress) {
+  size_t start = covered(room);
+  size_t offset = start;
+  size_t end = history.size(room);
+
+  while (offset < end && offset - start < maxBytes) {
+    string page = history.after(room, offset, HISTORY_PAGE);
+    size_t last = page.rfind('\n');
+    if (last == string::npos) {
+      return true; // nothing but a partial line left
+    }
+    page.erase(last + 1);
+    addLocked(room, page, offset);
+    offset += page.size();
+    if (progress) {
+      progress(offset - start, end - start);
+    }
+  }
+  return offset >= end;
+}
+
+void SearchIndex::merge(const string &room) {
+  string tailPath = history.path(room, ".ixt");
+  string sortedPath = history.path(room, ".ixs");
+  string mergedPath = history.path(room, ".ixm");
+
+  // straight into the vector, in chunks, with no second copy of the tail
+  vector<Posting> tail(sd.fileSize(tailPath) / sizeof(Posting));
+  File tailFile = sd.openFile(tailPath, FILE_READ);
+  size_t read = 0;
+  while (tailFile && read < tail.size()) {
+    size_t count = std::min(tail.size() - read, (size_t)SEARCH_READ_CHUNK);
+    size_t got = tailFile.read((uint8_t *)(tail.data() + read),
+                               count * sizeof(Posting)) /
+                 sizeof(Posting);
+    if (!got) {
+      break;
+    }
+    read += got;
+  }
+  if (tailFile) {
+    tailFile.close();
+  }
+  tail.resize(read);
+  std::sort(tail.begin(), tail.end());
+
+  File in = sd.openFile(sortedPath, FILE_READ);
+  File out = sd.openFile(mergedPath, FILE_WRITE);
+  if (!out) {
+    return;
+  }
+
+  // stream the sorted file through, tail postings slotted in along the way
+  Posting block[SEARCH_READ_CHUNK];
+  size_t blockSize = 0;
+  size_t blockPos = 0;
+  auto nextSorted = [&](Posting &posting) {
+    if (blockPos == blockSize) {
+      blockSize = in ? in.read((uint8_t *)block, sizeof(block)) /
+                           sizeof(Posting)
+                     : 0;
+      blockPos = 0;
+    }
+    if (blockPos == blockSize) {
+      return false;
+    }
+    posting = block[blockPos++];
+    return true;
+  };
+
+  Posting current;
+  bool haveSorted = nextSorted(current);
+  size_t t = 0;
+  while (haveSorted || t < tail.size()) {
+    if (haveSorted && (t == tail.size() || current < tail[t])) {
+      out.write((const uint8_t *)&current, sizeof(current));
+      haveSorted = nextSorted(current);
+    } else {
+      out.write((const uint8_t *)&tail[t++], sizeof(Posting));
+    }
+  }
+
+  if (in) {
+    in.close();
+  }
+  out.close();
+
+  sd.deleteFile(sortedPath);
+  sd.renameFile(mergedPath, sortedPath);
+  sd.deleteFile(tailPath);
+}
+
+vector<uint32_t> SearchIndex::lookup(const string &room, uint32_t hash) {
+  vector<uint32_t> offsets;
+
+  File file = sd.openFile(history.path(room, ".ixs"), FILE_READ);
+  if (file) {
+    // lower bound of `hash` over the fixed size records
+    size_t low = 0;
+    size_t high = file.size() / sizeof(Posting);
+    Posting posting;
+    while (low < high) {
+      size_t mid = (low + high) / 2;
+      file.seek(mid * sizeof(Posting));
+      file.read((uint8_t *)&posting, sizeof(posting));
+      if (posting.hash < hash) {
+        low = mid + 1;
+      } else {
+        high = mid;
+      }
+    }
+
+    file.seek(low * sizeof(Posting));
+    while (file.read((uint8_t *)&posting, sizeof(posting)) == sizeof(posting) &&
+           posting.hash == hash) {
+      offsets.push_back(posting.offset);
+    }
+    file.close();
+  }
+  return offsets;
+}
+
+void SearchIndex::scanTail(const string &room, const vector<uint32_t> &hashes,
+                           vector<vector<uint32_t>> &offsets) {
+  File file = sd.openFile(history.path(room, ".ixt"), FILE_READ);
+  if (!file) {
+    return;
+  }
+  Posting block[SEARCH_READ_CHUNK];
+  size_t count;
+  while ((count = file.read((uint8_t *)block, sizeof(block)) /
+                  sizeof(Posting)) > 0) {
+    for (size_t i = 0; i < count; ++i) {
+      for (size_t h = 0; h < hashes.size(); ++h) {
+        if (block[i].hash == hashes[h]) {
+          offsets[h].push_back(block[i].offset);
+        }
+      }
+    }
+  }
+  file.close();
+}
+
+vector<SearchHit> SearchIndex::search(
+    const string &room, const string &query,
+    const std::function<void(size_t, size_t)> &progress) {
+  std::lock_guard<std::mutex> lock(mutex);
+  vector<SearchHit> hits;
+  if (!history.available()) {
+    return hits;
+  }
+  // usually only what the message task has not got to yet
+  indexLog(room, SIZE_MAX, progress);
+
+  vector<uint32_t> hashes;
+  for_each_word(query.c_str(), query.size(),
+                [&](uint32_t hash) { hashes.push_back(hash); });
+  if (hashes.empty()) {
+    return hits;
+  }
+
+  // postings of every word, the tail read once for all of them
+  vector<vector<uint32_t>> found(hashes.size());
+  for (size_t i = 0; i < hashes.size(); ++i) {
+    found[i] = lookup(room, hashes[i]);
+  }
+  scanTail(room, hashes, found);
+
+  // lines holding every word
+  vector<uint32_t> offsets;
+  for (size_t i = 0; i < found.size(); ++i) {
+    std::sort(found[i].begin(), found[i].end());
+    if (i == 0) {
+      offsets.swap(found[i]);
+      continue;
+    }
+    vector<uint32_t> both;
+    std::set_intersection(offsets.begin(), offsets.end(), found[i].begin(),
+                          found[i].end(), std::back_inserter(both));
+    offsets.swap(both);
+  }
+
+  // split the query the way lines were split, to weed out hash collisions
+  vector<string> words;
+  string word;
+  for (size_t i = 0; i <= query.size(); ++i) {
+    unsigned char c = i < query.size() ? query[i] : ' ';
+    if (isalnum(c) || c >= 0x80) {
+      word += c;
+    } else {
+      if (word.size() >= SEARCH_MIN_WORD) {
+        words.push_back(word);
+      }
+      word.clear();
+    }
+  }
+
+  string logPath = history.path(room, ".log");
+  for (auto it = offsets.rbegin();
+       it != offsets.rend() && hits.size() < SEARCH_MAX_RESULTS; ++it) {
+    // a few short reads for most lines, longer ones keep going
+    string line;
+    size_t end = string::npos;
+    while (end == string::npos && line.size() < SEARCH_LINE_MAX) {
+      string part = sd.readFileRange(logPath, *it + line.size(), 256);
+      if (part.empty()) {
+        break;
+      }
+      end = part.find('\n');
+      line.append(part, 0, end);
+    }
+
+    bool match = true;
+    for (const auto &w : words) {
+      match = match && contains_word(line, w);
+    }
+    if (match) {
+      hits.push_back(SearchHit{*it, line});
+    }
+  }
+  return hits;
+}
@@ -0,0 +1,77 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include "SdService.h"
+#include "history.h"
+
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+#define SEARCH_MERGE_RECORDS 4096 // tail postings folded into the sorted file at once
+#define SEARCH_MAX_RESULTS 50
+#define SEARCH_MIN_WORD 2
+#define SEARCH_READ_CHUNK 64   // postings read from the SD card at once
+#define SEARCH_LINE_MAX 4096   // bytes of a log line read to check a hit
+#define SEARCH_CATCH_UP_STEP 8192 // bytes of log the message task indexes per poll
+
+struct SearchHit
+{
+    size_t offset; // of the line in the room's history log
+    string text;
+};
+
+// Inverted index over the history logs. Every word of a line becomes a
+// posting (word hash, line offset). New postings are appended to a small
+// unsorted tail file, which is merged into a file sorted by hash once it
+// holds SEARCH_MERGE_RECORDS. A lookup is a binary search in the sorted
+// file plus a scan of the tail.
+class SearchIndex
+{
+public:
+    SearchIndex(SdService &sd, History &history);
+
+    // Indexes `text`, which was appended to the room's log at `offset`
+    void add(const string &room, const string &text, size_t offset);
+    // Indexes about `maxBytes` more of the room's log, whole pages at a time,
+    // from a background task between polls. True once all of it is indexed.
+    // False without waiting while a search holds the index, that search
+    // catches up itself.
+    bool catchUp(const string &room, size_t maxBytes);
+    // Newest lines holding every word of `query`, after indexing any part of
+    // the log not covered yet. `progress` gets the bytes indexed so far and
+    // the bytes there were to index, after every page.
+    vector<SearchHit> search(const string &room, const string &query,
+                             const std::function<void(size_t, size_t)> &progress = nullptr);
+
+private:
+    struct Posting
+    {
+        uint32_t hash;
+        uint32_t offset;
+        bool operator<(const Posting &other) const
+        {
+            return hash != other.hash ? hash < other.hash : offset < other.offset;
+        }
+    };
+
+    void addLocked(const string &room, const string &text, size_t offset);
+    bool indexLog(const string &room, size_t maxBytes,
+                  const std::function<void(size_t, size_t)> &progress);
+    void merge(const string &room);
+    vector<uint32_t> lookup(const string &room, uint32_t hash);
+    // Adds the offsets of tail postings to those of their hash in `hashes`
+    void scanTail(const string &room, const vector<uint32_t> &hashes,
+                  vector<vector<uint32_t>> &offsets);
+    size_t covered(const string &room);
+
+    SdService &sd;
+    History &history;
+    std::mutex mutex;
+};
+
+#endif // SEARCH_H
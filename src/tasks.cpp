@@ -0,0 +1,112 @@
+#include "tasks.h"
+
+#include <Arduino.h>
+#include <esp_freertos_hooks.h>
+#include <esp_timer.h>
+
+#include <mutex>
+
+#define IDLE_GAP_US 100 // a longer gap between idle hook calls is another task
+
+struct TaskEntry {
+  TaskHandle_t handle;
+  const char *name;
+  uint32_t stack;
+  int core;
+  unsigned priority;
+};
+
+// held while creating a task too, so one that ends right away is never
+// listed after it is gone
+static std::mutex tasksMutex;
+static std::vector<TaskEntry> tasks;
+
+bool startTask(TaskFunction_t task, const char *name, uint32_t stack,
+               void *params, UBaseType_t priority, BaseType_t core) {
+  std::lock_guard<std::mutex> lock(tasksMutex);
+  TaskHandle_t handle = nullptr;
+  if (xTaskCreatePinnedToCore(task, name, stack, params, priority, &handle,
+                              core) != pdPASS) {
+    return false;
+  }
+  tasks.push_back(TaskEntry{handle, name, stack, (int)core, priority});
+  return true;
+}
+
+void registerTask(const char *name, uint32_t stack, BaseType_t core) {
+  std::lock_guard<std::mutex> lock(tasksMutex);
+  tasks.push_back(TaskEntry{xTaskGetCurrentTaskHandle(), name, stack,
+                            (int)core, 1});
+}
+
+void finishTask() {
+  {
+    std::lock_guard<std::mutex> lock(tasksMutex);
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    for (auto it = tasks.begin(); it != tasks.end(); ++it) {
+      if (it->handle == self) {
+        tasks.erase(it);
+        break;
+      }
+    }
+  }
+  vTaskDelete(NULL);
+}
+
+std::vector<TaskInfo> taskInfo() {
+  std::lock_guard<std::mutex> lock(tasksMutex);
+  std::vector<TaskInfo> out;
+  for (auto &entry : tasks) {
+    // the ESP-IDF high water mark is in bytes
+    out.push_back(TaskInfo{entry.name, entry.stack,
+                           (uint32_t)uxTaskGetStackHighWaterMark(entry.handle),
+                           entry.core, entry.priority});
+  }
+  return out;
+}
+
+// microseconds spent idle, written only by the idle hook of each core
+static volatile uint32_t idleMicros[CORE_COUNT];
+static int64_t idleSeen[CORE_COUNT];
+static uint32_t sampleIdle[CORE_COUNT];
+static int64_t sampleAt = 0;
+
+static bool countIdle(int core) {
+  int64_t now = esp_timer_get_time();
+  int64_t gap = now - idleSeen[core];
+  if (gap < IDLE_GAP_US) {
+    idleMicros[core] += (uint32_t)gap;
+  }
+  idleSeen[core] = now;
+  return false; // called again at once rather than after the next interrupt
+}
+
+static bool countIdle0() { return countIdle(0); }
+static bool countIdle1() { return countIdle(1); }
+
+void measureCores(bool on) {
+  if (on) {
+    sampleAt = 0;
+    esp_register_freertos_idle_hook_for_cpu(countIdle0, 0);
+    esp_register_freertos_idle_hook_for_cpu(countIdle1, 1);
+  } else {
+    esp_deregister_freertos_idle_hook_for_cpu(countIdle0, 0);
+    esp_deregister_freertos_idle_hook_for_cpu(countIdle1, 1);
+  }
+}
+
+bool coreBusy(int busy[CORE_COUNT]) {
+  int64_t now = esp_timer_get_time();
+  bool known = sampleAt != 0 && now > sampleAt;
+  for (int core = 0; core < CORE_COUNT; ++core) {
+    uint32_t idle = idleMicros[core];
+    if (known) {
+      uint32_t percent =
+          (uint32_t)((uint64_t)(idle - sampleIdle[core]) * 100 / (now - sampleAt));
+      busy[core] = 100 - (int)std::min<uint32_t>(percent, 100);
+    }
+    sampleIdle[core] = idle;
+  }
+  sampleAt = now;
+  return known;
+}
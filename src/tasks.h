@@ -0,0 +1,54 @@
+#ifndef TASKS_H
+#define TASKS_H
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <string>
+#include <vector>
+
+// Network I/O and TLS share core 0 with the WiFi driver, the UI loop and LCD
+// traffic keep core 1 to themselves
+#define NETWORK_CORE 0
+#define UI_CORE 1
+#define CORE_COUNT 2
+
+// Stack sizes in bytes, not yet sized from a device soak. The task screen
+// and `stack_free` in the metrics log show how much of each was never used.
+#define TASK_STACK_MESSAGE 8192
+#define TASK_STACK_PREFETCH 8192
+#define TASK_STACK_OUTBOX 8192 // sends over TLS like the two above
+#define TASK_STACK_SD_WRITER 4096
+#define TASK_STACK_UI 8192 // Arduino loop task, CONFIG_ARDUINO_LOOP_STACK_SIZE
+
+#define TASK_PRIORITY_NETWORK 2
+#define TASK_PRIORITY_SD 1 // below the network, SD writes are never urgent
+
+struct TaskInfo
+{
+    std::string name;
+    uint32_t stack;     // bytes
+    uint32_t freeStack; // bytes never used, the high water mark
+    int core;
+    unsigned priority;
+};
+
+// Creates a task pinned to `core` and lists it on the task screen
+bool startTask(TaskFunction_t task, const char *name, uint32_t stack, void *params,
+               UBaseType_t priority, BaseType_t core);
+// Lists the calling task, for tasks the framework created
+void registerTask(const char *name, uint32_t stack, BaseType_t core);
+// Ends the calling task, in place of vTaskDelete(NULL)
+void finishTask();
+
+std::vector<TaskInfo> taskInfo();
+
+// Counts the time each core spends in its idle task while on. The idle hooks
+// keep the cores from sleeping between ticks, so only the task screen
+// turns it on.
+void measureCores(bool on);
+// Percent of the time each core ran other tasks since the previous call,
+// false on the first call after measuring started
+bool coreBusy(int busy[CORE_COUNT]);
+
+#endif // TASKS_H
@@ -0,0 +1,46 @@
+#include "telemetry.h"
+
+#include <M5Cardputer.h>
+#include <WiFi.h>
+
+Telemetry telemetry;
+
+void Telemetry::publishLink() {
+  uint32_t now = millis();
+  uint32_t last = lastLink;
+  // one task reads at a time, the others skip this round
+  if (now - last < TELEMETRY_LINK_INTERVAL ||
+      !lastLink.compare_exchange_strong(last, now)) {
+    return;
+  }
+
+  bool up = WiFi.status() == WL_CONNECTED;
+  connected = up;
+  rssi = up ? WiFi.RSSI() : 0;
+  battery = M5.Power.getBatteryLevel();
+}
+
+void Telemetry::publishStart() { lastPoll = millis() | 1; }
+
+void Telemetry::publishPoll(bool ok) {
+  // 0 means never, a poll finishing at millis() 0 is off by one
+  uint32_t now = millis() | 1;
+  lastPoll = now;
+  if (ok) {
+    lastSync = now;
+  }
+}
+
+void Telemetry::publishQueue(size_t queued) {
+  this->queued = queued > UINT16_MAX ? UINT16_MAX : queued;
+}
+
+void Telemetry::publishBreaker(uint8_t state, uint32_t probeAt) {
+  breaker = state;
+  this->probeAt = probeAt;
+}
+
+TelemetrySnapshot Telemetry::snapshot() const {
+  return TelemetrySnapshot{connected, rssi,     battery, queued,
+                           lastSync,  lastPoll, breaker, probeAt};
+}
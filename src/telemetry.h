@@ -0,0 +1,53 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+#define TELEMETRY_LINK_INTERVAL 1000 // ms between RSSI and battery reads
+#define TELEMETRY_STUCK_AFTER 60000  // ms without a finished poll, above the long poll wait
+
+// Copy of the published values, taken field by field without locking
+struct TelemetrySnapshot
+{
+    bool connected;
+    int8_t rssi;        // dBm
+    int8_t battery;     // percent, -1 when unknown
+    uint16_t queued;    // outgoing messages waiting
+    uint32_t lastSync;  // millis() of the last successful poll, 0 for never
+    uint32_t lastPoll;  // millis() of the last finished poll, 0 for never
+    uint8_t breaker;    // BreakerState of the server in use
+    uint32_t probeAt;   // millis() of the next probe while the breaker is open
+};
+
+// Link and sync state published by the network tasks for the status bar.
+// Every field is an independent atomic, readers never block a writer.
+class Telemetry
+{
+public:
+    // Reads WiFi RSSI and the battery at most every TELEMETRY_LINK_INTERVAL ms
+    void publishLink();
+    // A poller starting counts as a finished poll, so it is not stuck yet
+    void publishStart();
+    void publishPoll(bool ok);
+    void publishQueue(size_t queued);
+    void publishBreaker(uint8_t state, uint32_t probeAt);
+
+    TelemetrySnapshot snapshot() const;
+
+private:
+    std::atomic<bool> connected{false};
+    std::atomic<int8_t> rssi{0};
+    std::atomic<int8_t> battery{-1};
+    std::atomic<uint16_t> queued{0};
+    std::atomic<uint32_t> lastSync{0};
+    std::atomic<uint32_t> lastPoll{0};
+    std::atomic<uint32_t> lastLink{0};
+    std::atomic<uint8_t> breaker{0};
+    std::atomic<uint32_t> probeAt{0};
+};
+
+extern Telemetry telemetry;
+
+#endif // TELEMETRY_H
@@ -0,0 +1,193 @@
+#include "textlayout.h"
+#include "utf8.h"
+
+#include <algorithm>
+
+void TextLayout::setTextSize(float size) {
+  M5.Lcd.setTextSize(size);
+  if (size == this->size) {
+    return;
+  }
+  this->size = size;
+
+  char glyph[2] = {0, 0};
+  widest = 0;
+  for (int c = 0; c < 95; ++c) {
+    glyph[0] = (char)(c + 32);
+    advances[c] = M5.Lcd.textWidth(glyph);
+    widest = std::max(widest, advances[c]);
+  }
+  height = M5.Lcd.fontHeight();
+  cache.clear();
+}
+
+void TextLayout::setTextColor(uint16_t color) {
+  this->color = color;
+  M5.Lcd.setTextColor(color);
+}
+
+void TextLayout::setGlyphs(GlyphCache *glyphs) {
+  this->glyphs = glyphs && glyphs->available() ? glyphs : nullptr;
+  cache.clear();
+}
+
+int32_t TextLayout::advance(uint32_t codepoint) {
+  if (codepoint >= 32 && codepoint < 127) {
+    return advances[codepoint - 32];
+  }
+  if (codepoint >= 0x80 && glyphs) {
+    uint8_t w = glyphs->get(codepoint).width;
+    if (w) {
+      return w;
+    }
+  }
+  return widest; // drawn as an empty box
+}
+
+int32_t TextLayout::width(const char *text, size_t length) {
+  int32_t total = 0;
+  size_t i = 0;
+  while (i < length) {
+    total += advance(utf8Next(text, length, i));
+  }
+  return total;
+}
+
+void TextLayout::wrapUncached(const char *text, size_t length,
+                              int32_t maxWidth, vector<LineSpan> &out) {
+  size_t start = 0;
+  size_t space = 0; // last space on the row, 0 when there is none
+  int32_t rowWidth = 0;
+
+  size_t i = 0;
+  while (i < length) {
+    size_t at = i;
+    uint32_t codepoint = utf8Next(text, length, i);
+    int32_t w = advance(codepoint);
+
+    if (rowWidth + w > maxWidth && at > start) {
+      if (space > start) {
+        // break after the last word that fits, the space itself is dropped
+        out.push_back(LineSpan{(uint32_t)start, (uint32_t)(space - start)});
+        start = space + 1;
+        rowWidth = width(text + start, at - start);
+      } else {
+        out.push_back(LineSpan{(uint32_t)start, (uint32_t)(at - start)});
+        start = at;
+        rowWidth = 0;
+      }
+      space = 0;
+    }
+    if (codepoint == ' ') {
+      space = at;
+    }
+    rowWidth += w;
+  }
+
+  // an empty line still takes a row
+  if (start < length || out.empty()) {
+    out.push_back(LineSpan{(uint32_t)start, (uint32_t)(length - start)});
+  }
+}
+
+const vector<LineSpan> &TextLayout::wrap(const char *text, size_t length,
+                                         int32_t maxWidth) {
+  // FNV-1a picks the entry, djb2 checks it
+  uint32_t key = 2166136261u;
+  uint32_t check = 5381;
+  for (size_t i = 0; i < length; ++i) {
+    key = (key ^ (unsigned char)text[i]) * 16777619u;
+    check = check * 33 + (unsigned char)text[i];
+  }
+  key = (key ^ (uint32_t)maxWidth) * 16777619u;
+
+  auto it = cache.find(key);
+  if (it != cache.end()) {
+    LayoutEntry &entry = it->second;
+    if (entry.length == length && entry.maxWidth == maxWidth &&
+        entry.check == check) {
+      return entry.spans;
+    }
+    // a collision, the entry goes to this line
+    entry.spans.clear();
+  } else if (cache.size() >= LAYOUT_CACHE_ENTRIES) {
+    // the window only ever holds a few hundred lines, start over when full
+    cache.clear();
+  }
+  LayoutEntry &entry = cache[key];
+  entry.length = length;
+  entry.maxWidth = maxWidth;
+  entry.check = check;
+  wrapUncached(text, length, maxWidth, entry.spans);
+  return entry.spans;
+}
+
+size_t TextLayout::fitTail(const string &text, int32_t maxWidth) {
+  int32_t total = 0;
+  size_t start = text.size();
+  while (start > 0) {
+    size_t previous = utf8Previous(text.data(), start);
+    size_t i = previous;
+    int32_t w = advance(utf8Next(text.data(), text.size(), i));
+    if (total + w > maxWidth) {
+      break;
+    }
+    total += w;
+    start = previous;
+  }
+  return start;
+}
+
+size_t TextLayout::fitHead(const char *text, size_t length,
+                           int32_t maxWidth) {
+  int32_t total = 0;
+  size_t i = 0;
+  while (i < length) {
+    size_t next = i;
+    total += advance(utf8Next(text, length, next));
+    if (total > maxWidth) {
+      break;
+    }
+    i = next;
+  }
+  return i;
+}
+
+void TextLayout::draw(const char *text, size_t length, int32_t x, int32_t y) {
+  size_t i = 0;
+  while (i < length) {
+    // longest ASCII run from here goes out in one call
+    size_t end = i;
+    while (end < length && (unsigned char)text[end] < 0x80 &&
+           (unsigned char)text[end] >= ' ') {
+      ++end;
+    }
+    if (end > i) {
+      run.assign(text + i, end - i);
+      M5.Lcd.drawString(run.c_str(), x, y);
+      x += width(text + i, end - i);
+      i = end;
+      continue;
+    }
+
+    uint32_t codepoint = utf8Next(text, length, i);
+    if (codepoint == '\n') {
+      M5.Lcd.drawFastVLine(x + widest - 2, y + 1, height - 4, color);
+      M5.Lcd.drawFastHLine(x + 1, y + height - 4, widest - 3, color);
+      x += widest;
+      continue;
+    }
+    const Glyph *glyph =
+        glyphs && codepoint >= 0x80 && codepoint != UTF8_INVALID
+            ? &glyphs->get(codepoint)
+            : nullptr;
+    if (glyph && glyph->width) {
+      M5.Lcd.drawBitmap(x, y, glyph->bits.data(), glyph->width,
+                        glyphs->height(), color);
+      x += glyph->width;
+    } else {
+      M5.Lcd.drawRect(x + 1, y, widest - 2, height - 1, color);
+      x += widest;
+    }
+  }
+}
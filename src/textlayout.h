@@ -0,0 +1,76 @@
+#ifndef TEXTLAYOUT_H
+#define TEXTLAYOUT_H
+
+#include "glyphcache.h"
+
+#include <M5Cardputer.h>
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+#define LAYOUT_CACHE_ENTRIES 256 // wrapped message lines kept between renders
+
+// Part of a line of text that fits on one row of the screen. Offsets are
+// 32 bit, a pasted line can run past 64 KB.
+struct LineSpan
+{
+    uint32_t start;
+    uint32_t length;
+};
+
+// Measures and wraps UTF-8 text with the advance widths of the display font,
+// read once per text size instead of going through the print path per glyph.
+// Codepoints outside ASCII come from the glyph cache when one is set.
+class TextLayout
+{
+public:
+    // Reloads the advance table when `size` differs from the current one
+    void setTextSize(float size);
+    void setTextColor(uint16_t color);
+    void setGlyphs(GlyphCache *glyphs);
+
+    int32_t width(const char *text, size_t length);
+    int32_t lineHeight() const { return height; }
+
+    // Breaks one line (no '\n') into rows at most `maxWidth` wide, on spaces
+    // where possible and never inside a codepoint. The result is cached by
+    // content and width.
+    const vector<LineSpan> &wrap(const char *text, size_t length, int32_t maxWidth);
+    // Offset of the longest tail of `text` that fits in `maxWidth`
+    size_t fitTail(const string &text, int32_t maxWidth);
+    // Length of the longest head of `text` that fits in `maxWidth`
+    size_t fitHead(const char *text, size_t length, int32_t maxWidth);
+    // Draws ASCII runs with a single drawString each, other codepoints from
+    // the glyph cache and line breaks as a return mark
+    void draw(const char *text, size_t length, int32_t x, int32_t y);
+
+private:
+    int32_t advance(uint32_t codepoint);
+    void wrapUncached(const char *text, size_t length, int32_t maxWidth, vector<LineSpan> &out);
+
+    float size = 0;
+    int32_t height = 8;
+    uint16_t color = 0xffff;
+    uint8_t advances[95]; // printable ASCII
+    uint8_t widest = 6;
+    GlyphCache *glyphs = nullptr;
+    // Wrapped lines by a hash of text and width. The entry's length, width
+    // and second hash tell a hit from a collision, the spans of another
+    // line could reach past the end of this one.
+    struct LayoutEntry
+    {
+        size_t length;
+        int32_t maxWidth;
+        uint32_t check;
+        vector<LineSpan> spans;
+    };
+    std::unordered_map<uint32_t, LayoutEntry> cache;
+    string run;
+};
+
+#endif // TEXTLAYOUT_H
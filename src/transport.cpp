@@ -0,0 +1,161 @@
+#include "transport.h"
+#include "power.h"
+
+#include <ArduinoJson.h>
+#include <algorithm>
+
+// Blocks until `interval` or the poll interval of the power mode, whichever
+// is longer, passed since `last`, then moves it to now. Checked in TICKS
+// steps so a keypress shortens the wait. Meanwhile away mode may nap.
+// Returns early once `cancel` is cancelled.
+static void pace(unsigned long &last, uint32_t interval, Cancellation *cancel) {
+  while (!(cancel && cancel->cancelled())) {
+    uint32_t wait = std::max(interval, power.pollInterval());
+    unsigned long elapsed = millis() - last;
+    if (elapsed >= wait) {
+      break;
+    }
+    power.networkIdle(last + wait);
+    unsigned long left = wait - elapsed;
+    delay(left < TICKS ? left : TICKS);
+  }
+  power.networkIdle(0);
+  last = millis();
+}
+
+PollTransport::PollTransport(MessageJar *user, std::mutex *userMutex)
+    : user(user), userMutex(userMutex) {}
+
+bool PollTransport::next(const string &room, size_t latest,
+                         vector<Message> &out, Arena &arena) {
+  if (first) {
+    first = false; // get messages right away
+    lastRequest = millis();
+  } else {
+    pace(lastRequest, interval, cancel);
+  }
+
+  std::lock_guard<std::mutex> lock(*userMutex);
+  return user->get_messages(room, latest, out, arena, buffers, 0, cancel) ==
+         RESPONSE_OK;
+}
+
+LongPollTransport::LongPollTransport(MessageJar *user) : user(user) {}
+
+bool LongPollTransport::next(const string &room, size_t latest,
+                             vector<Message> &out, Arena &arena) {
+  pace(lastRequest, interval, cancel);
+
+  // userMutex is not held while the server waits, sending must not stall
+  // for LONG_POLL_WAIT seconds. Leaving the room cancels the wait.
+  bool ok = user->get_messages(room, latest, out, arena, buffers,
+                               LONG_POLL_WAIT, cancel) == RESPONSE_OK;
+  if (cancelled()) {
+    return false;
+  }
+
+  if (ok && out.empty() && millis() - lastRequest < LONG_POLL_WAIT * 500) {
+    // an early empty answer, the server ignored the wait
+    if (++strikes >= LONG_POLL_STRIKES) {
+      notOffered = true;
+    }
+  } else if (ok) {
+    strikes = 0;
+  }
+  return ok;
+}
+
+SseTransport::SseTransport(MessageJar *user) : user(user) {}
+
+SseTransport::~SseTransport() { close(); }
+
+void SseTransport::close() {
+  if (open) {
+    http.end();
+    open = false;
+  }
+  line.clear();
+}
+
+bool SseTransport::next(const string &room, size_t latest,
+                        vector<Message> &out, Arena &arena) {
+  out.clear();
+
+  if (!open) {
+    bool unsupported;
+    open =
+        user->open_stream(room, latest, client, http, buffers.body, unsupported);
+    if (!open) {
+      notOffered = unsupported;
+      delay(TICKS);
+      return false;
+    }
+  }
+
+  WiFiClient *stream = http.getStreamPtr();
+  unsigned long start = millis();
+
+  while (millis() - start < STREAM_IDLE_TIMEOUT && !cancelled()) {
+    while (stream->available() > 0) {
+      char c = stream->read();
+      if (c == '\r') {
+        continue;
+      }
+      if (c != '\n') {
+        line += c;
+        continue;
+      }
+
+      if (line.compare(0, 5, "data:") == 0) {
+        // same message object /get returns, without the string wrapping
+        JsonDocument doc(&arena);
+        const char *data = line.c_str() + 5;
+        if (!deserializeJson(doc, *data == ' ' ? data + 1 : data)) {
+          out.emplace_back(doc.as<JsonObjectConst>());
+        }
+      } else if (line.empty() && !out.empty()) {
+        return true; // end of an event
+      }
+      line.clear();
+    }
+
+    if (!stream->connected()) {
+      // reopened on the next call from the new `latest`
+      close();
+      return false;
+    }
+    delay(20);
+  }
+  return true;
+}
+
+Transport *makeTransport(TransportMode mode, MessageJar *user,
+                         std::mutex *userMutex, uint32_t interval,
+                         Cancellation *cancel) {
+  Transport *transport;
+  switch (mode) {
+  case TRANSPORT_SSE:
+    transport = new SseTransport(user);
+    break;
+  case TRANSPORT_LONG_POLL:
+    transport = new LongPollTransport(user);
+    break;
+  default:
+    transport = new PollTransport(user, userMutex);
+    break;
+  }
+  transport->setInterval(interval);
+  transport->setCancellation(cancel);
+  return transport;
+}
+
+TransportMode transportFromName(const string &name) {
+  if (name == "poll") {
+    return TRANSPORT_POLL;
+  }
+  if (name == "longpoll") {
+    return TRANSPORT_LONG_POLL;
+  }
+  // "sse", or anything else: start at the top and fall back as needed
+  return TRANSPORT_SSE;
+}
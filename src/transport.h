@@ -0,0 +1,106 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include "arena.h"
+#include "messagejar.h"
+
+#include <HTTPClient.h>
+#include <WiFiClientSecure.h>
+#include <mutex>
+#include <string>
+
+#define TICKS 1000               // ms between polls when active, and minimum between any two requests
+#define LONG_POLL_WAIT 20        // seconds the server may hold a long poll
+#define LONG_POLL_STRIKES 3      // early empty answers before long polling is given up
+#define STREAM_IDLE_TIMEOUT 1000 // ms an event stream is read before returning empty
+
+// Ordered from least to most capable, a mode that turns out not to be offered
+// by the server falls back to the one below it
+enum TransportMode
+{
+    TRANSPORT_POLL,
+    TRANSPORT_LONG_POLL,
+    TRANSPORT_SSE,
+};
+
+// How messageTask learns about new messages in a room
+class Transport
+{
+public:
+    virtual ~Transport() {}
+    virtual TransportMode mode() const = 0;
+
+    // Waits for messages after `latest` and puts them in `out`, which may be
+    // left empty. Returns false when the request failed.
+    virtual bool next(const string &room, size_t latest, vector<Message> &out, Arena &arena) = 0;
+
+    // Set once the server has shown it does not offer this mode
+    bool unsupported() const { return notOffered; }
+
+    // Least ms between two polls, the power mode may stretch it further
+    void setInterval(uint32_t ms) { interval = ms; }
+    // Ends waits and requests early once cancelled, when the room is left
+    void setCancellation(Cancellation *cancel) { this->cancel = cancel; }
+
+protected:
+    bool cancelled() const { return cancel && cancel->cancelled(); }
+
+    bool notOffered = false;
+    uint32_t interval = TICKS;
+    Cancellation *cancel = nullptr;
+    PollBuffers buffers; // this transport's own, see MessageJar
+};
+
+// A /get every TICKS ms, what the client always did
+class PollTransport : public Transport
+{
+public:
+    PollTransport(MessageJar *user, std::mutex *userMutex);
+    TransportMode mode() const override { return TRANSPORT_POLL; }
+    bool next(const string &room, size_t latest, vector<Message> &out, Arena &arena) override;
+
+private:
+    MessageJar *user;
+    std::mutex *userMutex;
+    unsigned long lastRequest = 0;
+    bool first = true;
+};
+
+// A /get the server holds for up to LONG_POLL_WAIT seconds
+class LongPollTransport : public Transport
+{
+public:
+    LongPollTransport(MessageJar *user);
+    TransportMode mode() const override { return TRANSPORT_LONG_POLL; }
+    bool next(const string &room, size_t latest, vector<Message> &out, Arena &arena) override;
+
+private:
+    MessageJar *user;
+    unsigned long lastRequest = 0;
+    uint8_t strikes = 0;
+};
+
+// Server sent events from /stream, one message per event
+class SseTransport : public Transport
+{
+public:
+    SseTransport(MessageJar *user);
+    ~SseTransport();
+    TransportMode mode() const override { return TRANSPORT_SSE; }
+    bool next(const string &room, size_t latest, vector<Message> &out, Arena &arena) override;
+
+private:
+    void close();
+
+    MessageJar *user;
+    WiFiClientSecure client;
+    HTTPClient http;
+    bool open = false;
+    string line;
+};
+
+Transport *makeTransport(TransportMode mode, MessageJar *user, std::mutex *userMutex,
+                         uint32_t interval = TICKS, Cancellation *cancel = nullptr);
+TransportMode transportFromName(const string &name);
+
+#endif // TRANSPORT_H
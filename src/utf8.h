@@ -0,0 +1,61 @@
+#ifndef UTF8_H
+#define UTF8_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+#define UTF8_INVALID 0xfffd // stands in for malformed sequences
+
+// Decodes the codepoint starting at text[i] and moves i past it. A malformed
+// sequence yields UTF8_INVALID and consumes a single byte.
+inline uint32_t utf8Next(const char *text, size_t length, size_t &i)
+{
+    unsigned char c = text[i++];
+    if (c < 0x80)
+    {
+        return c;
+    }
+
+    int extra = c >= 0xf8 ? -1 : c >= 0xf0 ? 3 : c >= 0xe0 ? 2 : c >= 0xc0 ? 1 : -1;
+    if (extra < 0 || i + extra > length)
+    {
+        return UTF8_INVALID;
+    }
+
+    uint32_t codepoint = c & (0x3f >> extra);
+    for (int k = 0; k < extra; ++k)
+    {
+        unsigned char next = text[i + k];
+        if ((next & 0xc0) != 0x80)
+        {
+            return UTF8_INVALID;
+        }
+        codepoint = (codepoint << 6) | (next & 0x3f);
+    }
+    i += extra;
+    return codepoint;
+}
+
+// Start of the codepoint that ends right before text[i]
+inline size_t utf8Previous(const char *text, size_t i)
+{
+    size_t start = i;
+    while (start > 0)
+    {
+        --start;
+        if ((text[start] & 0xc0) != 0x80 || i - start == 4)
+        {
+            break;
+        }
+    }
+    return start;
+}
+
+// Removes the last codepoint rather than the last byte
+inline void utf8PopBack(std::string &text)
+{
+    text.erase(utf8Previous(text.data(), text.size()));
+}
+
+#endif // UTF8_H
@@ -0,0 +1,44 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <chrono>
+#include <stdio.h>
+#include <vector>
+
+// A benchmark is a function registered with BENCH that prints its own
+// figures. The times are the host's, compare them with each other rather
+// than with the device, the counts of SD reads and bytes carry over.
+struct BenchCase
+{
+    const char *name;
+    void (*run)();
+};
+
+std::vector<BenchCase> &benchCases();
+
+struct BenchRegistration
+{
+    BenchRegistration(const char *name, void (*run)()) { benchCases().push_back(BenchCase{name, run}); }
+};
+
+#define BENCH(name)                                             \
+    static void name();                                         \
+    static BenchRegistration name##Registration(#name, name);   \
+    static void name()
+
+// Microseconds since an arbitrary start
+inline double benchMicros()
+{
+    return std::chrono::duration<double, std::micro>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// Deterministic, so runs compare
+inline uint32_t benchRandom(uint32_t &state)
+{
+    state = state * 1664525 + 1013904223;
+    return state >> 8;
+}
+
+#endif // BENCH_H
@@ -0,0 +1,183 @@
+#include "bench.h"
+#include "fakes.h"
+#include "textlayout.h"
+
+#include <algorithm>
+#include <string>
+
+#define BENCH_LINES 2000
+#define BENCH_PASSES 20
+#define BENCH_CJK 2000 // ideographs in the font, a chat uses a few hundred
+
+// Chat lines of a few to a couple of hundred characters
+static string chatLine(uint32_t &state) {
+  static const char *const WORDS[] = {"the", "weather", "meeting", "at",
+                                      "lunch", "code", "review", "tomorrow",
+                                      "ok", "sounds", "good", "afterwards"};
+  string text = "user" + std::to_string(benchRandom(state) % 7) + ":";
+  for (uint32_t words = 1 + benchRandom(state) % 40; words; --words) {
+    text += " ";
+    text += WORDS[benchRandom(state) % 12];
+  }
+  return text;
+}
+
+// Wraps a window of chat lines the way the terminal renders them, with the
+// cache cleared before each pass and then kept, and draws the rows
+BENCH(textLayout) {
+  uint32_t state = 35;
+  vector<string> lines;
+  size_t bytes = 0;
+  for (int i = 0; i < BENCH_LINES; ++i) {
+    lines.push_back(chatLine(state));
+    bytes += lines.back().size();
+  }
+
+  TextLayout layout;
+  layout.setTextSize(1);
+  size_t rows = 0;
+  double start = benchMicros();
+  for (int pass = 0; pass < BENCH_PASSES; ++pass) {
+    layout.setGlyphs(nullptr); // clears the cache
+    for (const string &line : lines) {
+      rows += layout.wrap(line.data(), line.size(), M5.Lcd.width()).size();
+    }
+  }
+  double micros = benchMicros() - start;
+  printf("  wrap uncached %6.2f us a line, %6.1f MB/s, %.1f rows a line\n",
+         micros / (BENCH_PASSES * BENCH_LINES),
+         (double)bytes * BENCH_PASSES / micros,
+         (double)rows / (BENCH_PASSES * BENCH_LINES));
+
+  // the last LAYOUT_CACHE_ENTRIES lines, as a redraw of the window wraps them
+  size_t window = lines.size() - LAYOUT_CACHE_ENTRIES / 2;
+  start = benchMicros();
+  for (int pass = 0; pass < BENCH_PASSES; ++pass) {
+    for (size_t i = window; i < lines.size(); ++i) {
+      layout.wrap(lines[i].data(), lines[i].size(), M5.Lcd.width());
+    }
+  }
+  micros = benchMicros() - start;
+  printf("  wrap cached   %6.2f us a line\n",
+         micros / (BENCH_PASSES * (lines.size() - window)));
+
+  size_t draws = M5.Lcd.draws;
+  start = benchMicros();
+  for (int pass = 0; pass < BENCH_PASSES; ++pass) {
+    for (size_t i = window; i < lines.size(); ++i) {
+      for (const LineSpan &span :
+           layout.wrap(lines[i].data(), lines[i].size(), M5.Lcd.width())) {
+        layout.draw(lines[i].data() + span.start, span.length, 0, 0);
+      }
+    }
+  }
+  micros = benchMicros() - start;
+  size_t drawn = BENCH_PASSES * (lines.size() - window);
+  printf("  draw          %6.2f us a line, %.1f draw calls a line\n",
+         micros / drawn, (double)(M5.Lcd.draws - draws) / drawn);
+}
+
+// Appends the UTF-8 of `codepoint`
+static void appendUtf8(string &text, uint32_t codepoint) {
+  if (codepoint < 0x80) {
+    text += (char)codepoint;
+  } else if (codepoint < 0x800) {
+    text += (char)(0xc0 | codepoint >> 6);
+    text += (char)(0x80 | (codepoint & 0x3f));
+  } else if (codepoint < 0x10000) {
+    text += (char)(0xe0 | codepoint >> 12);
+    text += (char)(0x80 | ((codepoint >> 6) & 0x3f));
+    text += (char)(0x80 | (codepoint & 0x3f));
+  } else {
+    text += (char)(0xf0 | codepoint >> 18);
+    text += (char)(0x80 | ((codepoint >> 12) & 0x3f));
+    text += (char)(0x80 | ((codepoint >> 6) & 0x3f));
+    text += (char)(0x80 | (codepoint & 0x3f));
+  }
+}
+
+// A chat line in Latin with accents, Greek, Cyrillic or Chinese, now and
+// then an emoji the font lacks. Ideographs are picked with a skew to the
+// common ones, like words in real text.
+static string mixedLine(uint32_t &state) {
+  string text = "user" + std::to_string(benchRandom(state) % 7) + ":";
+  uint32_t script = benchRandom(state) % 4;
+  for (uint32_t words = 1 + benchRandom(state) % 20; words; --words) {
+    text += " ";
+    for (uint32_t letters = 1 + benchRandom(state) % 6; letters; --letters) {
+      switch (script) {
+      case 0:
+        appendUtf8(text, benchRandom(state) % 3 ? 'a' + benchRandom(state) % 26
+                                               : 0xe0 + benchRandom(state) % 32);
+        break;
+      case 1:
+        appendUtf8(text, 0x3b1 + benchRandom(state) % 25);
+        break;
+      case 2:
+        appendUtf8(text, 0x430 + benchRandom(state) % 32);
+        break;
+      default:
+        appendUtf8(text, 0x4e00 + benchRandom(state) % BENCH_CJK *
+                                      (benchRandom(state) % BENCH_CJK) /
+                                      BENCH_CJK);
+        break;
+      }
+    }
+    if (benchRandom(state) % 16 == 0) {
+      appendUtf8(text, 0x1f600 + benchRandom(state) % 16);
+    }
+  }
+  return text;
+}
+
+// Wraps and draws mixed script lines through the glyph cache over a font on
+// the fake card, counting the misses and what they cost on the card
+BENCH(mixedScriptLayout) {
+  vector<uint32_t> codepoints;
+  for (uint32_t c = 0xa0; c < 0x250; ++c) {
+    codepoints.push_back(c);
+  }
+  for (uint32_t c = 0x370; c < 0x460; ++c) {
+    codepoints.push_back(c);
+  }
+  for (uint32_t c = 0x4e00; c < 0x4e00 + BENCH_CJK; ++c) {
+    codepoints.push_back(c);
+  }
+  hostFiles.clear();
+  hostFiles["/mjfont.bin"] = hostFont(12, codepoints);
+  SdService sd;
+  GlyphCache glyphs(sd, "/mjfont.bin");
+  size_t opens = hostSdOpens;
+  glyphs.begin();
+
+  uint32_t state = 36;
+  vector<string> lines;
+  size_t bytes = 0;
+  for (int i = 0; i < BENCH_LINES; ++i) {
+    lines.push_back(mixedLine(state));
+    bytes += lines.back().size();
+  }
+
+  TextLayout layout;
+  layout.setTextSize(1);
+  layout.setGlyphs(&glyphs);
+  uint64_t misses = hostCounters[COUNTER_GLYPH_MISSES];
+  size_t reads = hostSdReads;
+  size_t draws = M5.Lcd.draws;
+  double start = benchMicros();
+  for (const string &line : lines) {
+    for (const LineSpan &span :
+         layout.wrap(line.data(), line.size(), M5.Lcd.width())) {
+      layout.draw(line.data() + span.start, span.length, 0, 0);
+    }
+  }
+  double micros = benchMicros() - start;
+  printf("  wrap and draw %6.2f us a line, %6.1f MB/s, %.1f draw calls a line\n",
+         micros / BENCH_LINES, (double)bytes / micros,
+         (double)(M5.Lcd.draws - draws) / BENCH_LINES);
+  printf("  %.2f glyph misses a line, %.1f SD reads a miss, %zu SD opens\n",
+         (double)(hostCounters[COUNTER_GLYPH_MISSES] - misses) / BENCH_LINES,
+         (double)(hostSdReads - reads) /
+             std::max<uint64_t>(1, hostCounters[COUNTER_GLYPH_MISSES] - misses),
+         hostSdOpens - opens);
+}
@@ -0,0 +1,77 @@
+#include "bench.h"
+#include "fakes.h"
+#include "search.h"
+
+#include <string>
+
+#define BENCH_VOCABULARY 4000
+#define BENCH_QUERIES 200
+
+// Made up words, the low numbered ones far more common like in real text
+static string word(uint32_t &state) {
+  static const char *const SYLLABLES[] = {"ka", "lo", "mi", "ne", "ru",
+                                          "sa", "ti", "vo", "ze", "pa"};
+  uint32_t n = benchRandom(state) % BENCH_VOCABULARY *
+               (benchRandom(state) % BENCH_VOCABULARY) / BENCH_VOCABULARY;
+  string text;
+  do {
+    text += SYLLABLES[n % 10];
+    n /= 10;
+  } while (n);
+  return text;
+}
+
+static string line(uint32_t &state) {
+  string text = "user" + std::to_string(benchRandom(state) % 7) + ":";
+  for (uint32_t words = 3 + benchRandom(state) % 15; words; --words) {
+    text += " " + word(state);
+  }
+  return text + "\n";
+}
+
+static void query(SearchIndex &index, const char *label, const string &text) {
+  size_t reads = hostSdReads;
+  size_t hits = 0;
+  double start = benchMicros();
+  for (int i = 0; i < BENCH_QUERIES; ++i) {
+    hits = index.search("bench", text).size();
+  }
+  double micros = (benchMicros() - start) / BENCH_QUERIES;
+  printf("  query %-9s %6.1f us, %5.1f SD reads, %zu hits\n", label, micros,
+         (double)(hostSdReads - reads) / BENCH_QUERIES, hits);
+}
+
+// Builds the index over logs of several sizes in one go, as the first
+// search in a room used to, then times lookups of common and rare words
+BENCH(searchIndex) {
+  for (int lines : {2000, 20000}) {
+    hostFiles.clear();
+    SdService sd;
+    sd.begin();
+    History history(sd);
+    SearchIndex index(sd, history);
+
+    uint32_t state = 34;
+    string log;
+    for (int i = 0; i < lines; ++i) {
+      log += line(state);
+    }
+    hostFiles[history.path("bench", ".log")] = log;
+
+    size_t reads = hostSdReads;
+    double start = benchMicros();
+    index.catchUp("bench", SIZE_MAX);
+    double millis = (benchMicros() - start) / 1000;
+    size_t indexBytes = sd.fileSize(history.path("bench", ".ixs")) +
+                        sd.fileSize(history.path("bench", ".ixt"));
+    printf("  %d lines, %zu bytes of log: built in %.1f ms, %zu SD reads, "
+           "index %zu bytes (%.2f per log byte)\n",
+           lines, log.size(), millis, hostSdReads - reads, indexBytes,
+           (double)indexBytes / log.size());
+
+    query(index, "common", "ka");
+    query(index, "rare", "zezeze");
+    query(index, "two", "ka lo");
+    query(index, "missing", "nothing");
+  }
+}
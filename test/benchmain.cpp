@@ -0,0 +1,14 @@
+#include "bench.h"
+
+std::vector<BenchCase> &benchCases() {
+  static std::vector<BenchCase> cases;
+  return cases;
+}
+
+int main() {
+  for (const auto &bench : benchCases()) {
+    printf("%s\n", bench.name);
+    bench.run();
+  }
+  return 0;
+}
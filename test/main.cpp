@@ -0,0 +1,21 @@
+#include "test.h"
+
+int testFailures = 0;
+
+std::vector<TestCase> &testCases() {
+  static std::vector<TestCase> cases;
+  return cases;
+}
+
+int main() {
+  int failed = 0;
+  for (const auto &test : testCases()) {
+    int before = testFailures;
+    test.run();
+    bool ok = testFailures == before;
+    failed += !ok;
+    printf("%s %s\n", ok ? "pass" : "FAIL", test.name);
+  }
+  printf("%d of %d tests failed\n", failed, (int)testCases().size());
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,64 @@
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+// Just enough of the Arduino core for the host tests. Time only moves when a
+// test sets hostMillis or something calls delay().
+
+#include <algorithm>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+using std::max;
+using std::min;
+
+extern unsigned long hostMillis;
+
+inline unsigned long millis() { return hostMillis; }
+inline unsigned long micros() { return hostMillis * 1000; }
+inline void delay(unsigned long ms) { hostMillis += ms; }
+inline uint32_t esp_random() { return (uint32_t)rand(); }
+
+// Arduino's String, as far as the sources use it
+class String
+{
+public:
+    String(const char *text = "") : text(text) {}
+    String(const std::string &text) : text(text) {}
+    const char *c_str() const { return text.c_str(); }
+    unsigned int length() const { return text.size(); }
+    bool startsWith(const char *prefix) const { return text.compare(0, strlen(prefix), prefix) == 0; }
+    bool operator==(const char *other) const { return text == other; }
+    bool operator!=(const char *other) const { return text != other; }
+
+private:
+    std::string text;
+};
+
+class Print
+{
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size)
+    {
+        size_t n = 0;
+        while (n < size && write(buffer[n]))
+        {
+            ++n;
+        }
+        return n;
+    }
+};
+
+class Stream : public Print
+{
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+};
+
+#endif // ARDUINO_H
@@ -0,0 +1,41 @@
+#ifndef HTTPCLIENT_H
+#define HTTPCLIENT_H
+
+// Posts to FakeServer over a fake WiFiClientSecure, with the error codes of
+// the real HTTPClient
+
+#include <WiFiClientSecure.h>
+
+#define HTTPC_ERROR_CONNECTION_REFUSED (-1)
+#define HTTPC_ERROR_CONNECTION_LOST (-5)
+#define HTTPC_ERROR_READ_TIMEOUT (-11)
+#define HTTP_CODE_OK 200
+#define HTTP_CODE_NOT_FOUND 404
+#define HTTP_CODE_METHOD_NOT_ALLOWED 405
+
+struct FakeAnswer;
+
+class HTTPClient
+{
+public:
+    bool begin(WiFiClient &client, const char *url);
+    void end();
+    void setReuse(bool reuse) { this->reuse = reuse; }
+    void setTimeout(uint16_t timeout) { this->timeout = timeout; }
+    void useHTTP10(bool http10 = true) {}
+    void collectHeaders(const char *headerKeys[], const size_t headerKeysCount) {}
+    void addHeader(const char *name, const char *value) {}
+    void setAcceptEncoding(const char *encodings) {}
+    int POST(uint8_t *payload, size_t size);
+    String header(const char *name);
+    int writeToStream(Stream *stream);
+    WiFiClient *getStreamPtr() { return client; }
+
+private:
+    WiFiClient *client = nullptr;
+    const FakeAnswer *answer = nullptr;
+    bool reuse = false;
+    uint16_t timeout = 5000;
+};
+
+#endif // HTTPCLIENT_H
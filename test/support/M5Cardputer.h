@@ -0,0 +1,41 @@
+#ifndef M5CARDPUTER_H
+#define M5CARDPUTER_H
+
+// input.h includes the board header for its key codes, TextLayout for the
+// display. The fake display has the metrics of the built-in 6x8 font and
+// counts its draw calls instead of drawing.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+class HostLcd
+{
+public:
+    void setTextSize(float size) { textSize = size; }
+    void setTextColor(uint16_t color) {}
+    int32_t textWidth(const char *text) const { return (int32_t)(strlen(text) * 6 * textSize); }
+    int32_t fontHeight() const { return (int32_t)(8 * textSize); }
+    int32_t width() const { return 240; }
+    int32_t height() const { return 135; }
+
+    void drawString(const char *text, int32_t x, int32_t y) { ++draws; }
+    void drawFastVLine(int32_t x, int32_t y, int32_t h, uint16_t color) { ++draws; }
+    void drawFastHLine(int32_t x, int32_t y, int32_t w, uint16_t color) { ++draws; }
+    void drawRect(int32_t x, int32_t y, int32_t w, int32_t h, uint16_t color) { ++draws; }
+    void drawBitmap(int32_t x, int32_t y, const uint8_t *bits, int32_t w, int32_t h, uint16_t color) { ++draws; }
+
+    size_t draws = 0;
+
+private:
+    float textSize = 1;
+};
+
+struct HostM5
+{
+    HostLcd Lcd;
+};
+
+extern HostM5 M5;
+
+#endif // M5CARDPUTER_H
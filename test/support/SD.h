@@ -0,0 +1,35 @@
+#ifndef SD_H
+#define SD_H
+
+// A file on the card of the fake SdService, reads and writes go to hostFiles
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+class File
+{
+public:
+    File() {}
+    File(const std::string &path, const char *mode);
+
+    operator bool() const { return open; }
+    size_t read(uint8_t *buffer, size_t size);
+    size_t write(const uint8_t *buffer, size_t size);
+    size_t write(uint8_t c) { return write(&c, 1); }
+    bool seek(uint32_t position);
+    size_t position() const { return at; }
+    size_t size() const;
+    void close() { open = false; }
+
+private:
+    std::string path;
+    size_t at = 0;
+    bool open = false;
+};
+
+#endif // SD_H
@@ -0,0 +1,10 @@
+#ifndef SPI_H
+#define SPI_H
+
+class SPIClass
+{
+public:
+    SPIClass(int bus = 0) {}
+};
+
+#endif // SPI_H
@@ -0,0 +1,31 @@
+#ifndef WIFI_H
+#define WIFI_H
+
+// The network as far as the pool and requests use it, talking to FakeServer
+
+#include <Arduino.h>
+
+class IPAddress
+{
+};
+
+class WiFiClient : public Stream
+{
+public:
+    virtual uint8_t connected() { return false; }
+    virtual void stop() {}
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    size_t write(uint8_t c) override { return 0; }
+};
+
+class WiFiClass
+{
+public:
+    int hostByName(const char *host, IPAddress &ip) { return 1; }
+};
+
+extern WiFiClass WiFi;
+
+#endif // WIFI_H
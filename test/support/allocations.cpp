@@ -0,0 +1,22 @@
+#include "allocations.h"
+
+#include <new>
+#include <stdlib.h>
+
+size_t hostAllocations = 0;
+
+void *operator new(size_t size) {
+  ++hostAllocations;
+  void *ptr = malloc(size ? size : 1);
+  if (!ptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+
+void operator delete(void *ptr) noexcept { free(ptr); }
+void operator delete[](void *ptr) noexcept { free(ptr); }
+void operator delete(void *ptr, size_t size) noexcept { free(ptr); }
+void operator delete[](void *ptr, size_t size) noexcept { free(ptr); }
@@ -0,0 +1,10 @@
+#ifndef ALLOCATIONS_H
+#define ALLOCATIONS_H
+
+#include <stddef.h>
+
+// Calls of operator new so far, the test binary replaces it to count them.
+// Arena and ArduinoJson take their memory with malloc and are not counted.
+extern size_t hostAllocations;
+
+#endif // ALLOCATIONS_H
@@ -0,0 +1,60 @@
+// Stand-ins for the device-only parts the tested modules call into
+
+#include "fakes.h"
+#include "telemetry.h"
+
+#include <M5Cardputer.h>
+
+unsigned long hostMillis = 0;
+uint64_t hostCounters[COUNTER_COUNT] = {};
+
+HostM5 M5;
+Metrics metrics;
+Telemetry telemetry;
+
+void Metrics::add(Counter counter, uint32_t amount) {
+  std::lock_guard<std::mutex> lock(mutex);
+  counters[counter] += amount;
+  hostCounters[counter] += amount;
+}
+
+void Metrics::record(Timing timing, uint32_t micros) {}
+
+ScopedTiming::ScopedTiming(Timing timing) : timing(timing), start(0) {}
+ScopedTiming::~ScopedTiming() {}
+
+void Telemetry::publishBreaker(uint8_t state, uint32_t probeAt) {
+  breaker = state;
+  this->probeAt = probeAt;
+}
+
+TelemetrySnapshot Telemetry::snapshot() const {
+  TelemetrySnapshot snap = {};
+  snap.breaker = breaker;
+  snap.probeAt = probeAt;
+  return snap;
+}
+
+static void putU32(std::string &out, uint32_t value) {
+  for (int i = 0; i < 4; ++i) {
+    out += (char)(value >> (8 * i));
+  }
+}
+
+std::string hostFont(uint8_t height, const std::vector<uint32_t> &codepoints) {
+  std::string font = "MJF1";
+  font += (char)height;
+  font.append(3, '\0');
+  putU32(font, codepoints.size());
+
+  std::string glyphs;
+  size_t offset = font.size() + 8 * codepoints.size();
+  for (uint32_t codepoint : codepoints) {
+    putU32(font, codepoint);
+    putU32(font, offset + glyphs.size());
+    uint8_t width = codepoint >= 0x2e80 ? 8 : 6;
+    glyphs += (char)width;
+    glyphs.append((size_t)(width + 7) / 8 * height, (char)0x5a);
+  }
+  return font + glyphs;
+}
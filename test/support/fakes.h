@@ -0,0 +1,27 @@
+#ifndef FAKES_H
+#define FAKES_H
+
+#include "metrics.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+// What the fake Metrics counted, for the tests to read back
+extern uint64_t hostCounters[COUNTER_COUNT];
+
+// The SD card of the fake SdService, by path
+extern std::map<std::string, std::string> hostFiles;
+// Reads from the card so far, each one a round trip to the card on the device
+extern size_t hostSdReads;
+// Files opened so far, each a walk of the directory on the device
+extern size_t hostSdOpens;
+// Changes the SD card still takes, -1 for no limit. Once it reaches 0 every
+// write is lost, as if the power went right then.
+extern int hostSdWritesLeft;
+
+// A font as tools/pack_font.py packs it with a glyph for each of the sorted
+// `codepoints`, 8 pixels wide from the CJK blocks on and 6 below
+std::string hostFont(uint8_t height, const std::vector<uint32_t> &codepoints);
+
+#endif // FAKES_H
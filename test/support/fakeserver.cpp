@@ -0,0 +1,106 @@
+#include "fakeserver.h"
+
+#include <HTTPClient.h>
+#include <strings.h>
+
+FakeServer fakeServer;
+WiFiClass WiFi;
+
+void FakeServer::reset() {
+  pending.clear();
+  always = FakeAnswer{200, "[]", FAULT_NONE, ""};
+  respond = nullptr;
+  bodies = nullptr;
+  refuseConnects = false;
+  connects = 0;
+  requests = 0;
+  ++generation;
+}
+
+void FakeServer::script(int code, const std::string &body) {
+  pending.push_back(FakeAnswer{code, body, FAULT_NONE, ""});
+}
+
+void FakeServer::script(FakeFault fault) {
+  pending.push_back(FakeAnswer{0, "", fault, ""});
+}
+
+const FakeAnswer &FakeServer::next() {
+  ++requests;
+  if (bodies) {
+    bodies->push_back(lastBody);
+  }
+  if (respond) {
+    current = respond(lastBody);
+  } else if (pending.empty()) {
+    current = always;
+  } else {
+    current = pending.front();
+    pending.pop_front();
+  }
+  return current;
+}
+
+int WiFiClientSecure::connect(const char *host, uint16_t port,
+                              int32_t timeout) {
+  if (fakeServer.refuseConnects) {
+    return 0;
+  }
+  ++fakeServer.connects;
+  open = true;
+  generation = fakeServer.generation;
+  return 1;
+}
+
+uint8_t WiFiClientSecure::connected() {
+  return open && generation == fakeServer.generation;
+}
+
+bool HTTPClient::begin(WiFiClient &client, const char *url) {
+  this->client = &client;
+  fakeServer.lastUrl = url;
+  return true;
+}
+
+void HTTPClient::end() {
+  if (client && !reuse) {
+    client->stop();
+  }
+  client = nullptr;
+  answer = nullptr;
+}
+
+int HTTPClient::POST(uint8_t *payload, size_t size) {
+  if (!client || !client->connected()) {
+    return HTTPC_ERROR_CONNECTION_REFUSED;
+  }
+  fakeServer.lastBody.assign((const char *)payload, size);
+  const FakeAnswer &next = fakeServer.next();
+  switch (next.fault) {
+  case FAULT_TIMEOUT:
+    delay(timeout);
+    client->stop();
+    return HTTPC_ERROR_READ_TIMEOUT;
+  case FAULT_RESET:
+    client->stop();
+    return HTTPC_ERROR_CONNECTION_LOST;
+  default:
+    answer = &next;
+    return next.code;
+  }
+}
+
+String HTTPClient::header(const char *name) {
+  if (answer && strcasecmp(name, "Content-Encoding") == 0) {
+    return String(answer->encoding);
+  }
+  return String();
+}
+
+int HTTPClient::writeToStream(Stream *stream) {
+  if (!answer) {
+    return -1;
+  }
+  return (int)stream->write((const uint8_t *)answer->body.data(),
+                            answer->body.size());
+}
@@ -0,0 +1,61 @@
+#ifndef FAKESERVER_H
+#define FAKESERVER_H
+
+#include <deque>
+#include <functional>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+// What the fake server does with a request
+enum FakeFault
+{
+    FAULT_NONE,
+    FAULT_TIMEOUT, // no answer until the client's timeout
+    FAULT_RESET,   // the connection drops before the status line
+};
+
+struct FakeAnswer
+{
+    int code;
+    std::string body;
+    FakeFault fault;
+    std::string encoding; // Content-Encoding
+};
+
+// The other end of the fake WiFiClientSecure and HTTPClient. Answers requests
+// with `respond` when set, otherwise from a script, then with `always` once
+// the script is used up. Answers are
+// copied into a kept one, so a steady run does not allocate here.
+class FakeServer
+{
+public:
+    FakeServer() { reset(); }
+
+    // Forgets the script and counters and drops every connection
+    void reset();
+    void script(int code, const std::string &body);
+    void script(FakeFault fault);
+    // Ends every open connection, as a server closing idle ones would
+    void dropConnections() { ++generation; }
+
+    const FakeAnswer &next();
+
+    FakeAnswer always;
+    std::function<FakeAnswer(const std::string &body)> respond;
+    std::vector<std::string> *bodies; // every request body, when set
+    bool refuseConnects;
+    size_t connects;
+    size_t requests;
+    unsigned generation = 0;
+    std::string lastUrl;
+    std::string lastBody;
+
+private:
+    std::deque<FakeAnswer> pending;
+    FakeAnswer current;
+};
+
+extern FakeServer fakeServer;
+
+#endif // FAKESERVER_H
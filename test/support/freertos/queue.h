@@ -0,0 +1,6 @@
+#ifndef QUEUE_H
+#define QUEUE_H
+
+typedef void *QueueHandle_t;
+
+#endif // QUEUE_H
@@ -0,0 +1,8 @@
+#ifndef LWIP_SOCKETS_H
+#define LWIP_SOCKETS_H
+
+// shutdown() of the host, fake connections never have a socket to pass it
+
+#include <sys/socket.h>
+
+#endif // LWIP_SOCKETS_H
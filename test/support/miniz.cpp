@@ -0,0 +1,73 @@
+// tinfl_decompress on top of zlib. zlib keeps its own window, the caller's
+// is only written to, which is all inflate.cpp relies on. Like tinfl, which
+// reads ahead into its bit buffer, every call takes all the input it is
+// given, so output can still be pending once the input is used up.
+
+#include "rom/miniz.h"
+
+#include <map>
+#include <string>
+#include <zlib.h>
+
+struct HostInflate
+{
+    z_stream stream;
+    std::string input; // taken but not decoded yet
+};
+
+// ends the streams left open at exit, such as one abandoned half way
+struct HostStreams : std::map<tinfl_decompressor *, HostInflate>
+{
+    ~HostStreams()
+    {
+        for (auto &entry : *this)
+        {
+            inflateEnd(&entry.second.stream);
+        }
+    }
+};
+
+static HostStreams streams;
+
+tinfl_status tinfl_decompress(tinfl_decompressor *r, const mz_uint8 *pIn_buf_next,
+                              size_t *pIn_buf_size, mz_uint8 *pOut_buf_start,
+                              mz_uint8 *pOut_buf_next, size_t *pOut_buf_size,
+                              const mz_uint32 decomp_flags) {
+  bool known = streams.count(r);
+  HostInflate &state = streams[r];
+  z_stream &stream = state.stream;
+  if (r->m_state == 0) {
+    // tinfl_init was called, start a new stream
+    int bits = decomp_flags & TINFL_FLAG_PARSE_ZLIB_HEADER ? 15 : -15;
+    if (known) {
+      inflateEnd(&stream);
+    }
+    stream = z_stream();
+    state.input.clear();
+    if (inflateInit2(&stream, bits) != Z_OK) {
+      streams.erase(r);
+      return TINFL_STATUS_FAILED;
+    }
+    r->m_state = 1;
+  }
+
+  state.input.append((const char *)pIn_buf_next, *pIn_buf_size);
+  stream.next_in = (Bytef *)state.input.data();
+  stream.avail_in = (uInt)state.input.size();
+  stream.next_out = pOut_buf_next;
+  stream.avail_out = (uInt)*pOut_buf_size;
+  int result = inflate(&stream, Z_NO_FLUSH);
+  state.input.erase(0, state.input.size() - stream.avail_in);
+  *pOut_buf_size -= stream.avail_out;
+
+  if (result == Z_STREAM_END || (result != Z_OK && result != Z_BUF_ERROR)) {
+    // over either way, the next tinfl_init starts a new one
+    inflateEnd(&stream);
+    streams.erase(r);
+    return result == Z_STREAM_END ? TINFL_STATUS_DONE : TINFL_STATUS_FAILED;
+  }
+  if (stream.avail_out == 0) {
+    return TINFL_STATUS_HAS_MORE_OUTPUT;
+  }
+  return TINFL_STATUS_NEEDS_MORE_INPUT;
+}
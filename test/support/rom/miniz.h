@@ -0,0 +1,52 @@
+#ifndef MINIZ_H
+#define MINIZ_H
+
+// The tinfl part of the ESP32 ROM's miniz, as inflate.cpp uses it. On the
+// host it runs on zlib, see miniz.cpp.
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef unsigned char mz_uint8;
+typedef uint32_t mz_uint32;
+
+#define TINFL_LZ_DICT_SIZE 32768
+
+enum
+{
+    TINFL_FLAG_PARSE_ZLIB_HEADER = 1,
+    TINFL_FLAG_HAS_MORE_INPUT = 2,
+    TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF = 4,
+    TINFL_FLAG_COMPUTE_ADLER32 = 8
+};
+
+typedef enum
+{
+    TINFL_STATUS_BAD_PARAM = -3,
+    TINFL_STATUS_ADLER32_MISMATCH = -2,
+    TINFL_STATUS_FAILED = -1,
+    TINFL_STATUS_DONE = 0,
+    TINFL_STATUS_NEEDS_MORE_INPUT = 1,
+    TINFL_STATUS_HAS_MORE_OUTPUT = 2
+} tinfl_status;
+
+typedef struct
+{
+    mz_uint32 m_state; // 0 until the first call after tinfl_init
+} tinfl_decompressor;
+
+#define tinfl_init(r)     \
+    do                    \
+    {                     \
+        (r)->m_state = 0; \
+    } while (0)
+
+// Like the ROM's: `pOut_buf_next` points into a TINFL_LZ_DICT_SIZE window
+// that wraps, the sizes are updated to what was consumed and produced. It
+// stops with TINFL_STATUS_HAS_MORE_OUTPUT whenever the output space is
+// full, even with all input consumed.
+tinfl_status tinfl_decompress(tinfl_decompressor *r, const mz_uint8 *pIn_buf_next, size_t *pIn_buf_size,
+                              mz_uint8 *pOut_buf_start, mz_uint8 *pOut_buf_next, size_t *pOut_buf_size,
+                              const mz_uint32 decomp_flags);
+
+#endif // MINIZ_H
@@ -0,0 +1,134 @@
+// SdService over hostFiles, for the modules that keep their state on the card
+
+#include "SdService.h"
+#include "fakes.h"
+
+#include <algorithm>
+#include <string.h>
+
+std::map<std::string, std::string> hostFiles;
+int hostSdWritesLeft = -1;
+size_t hostSdReads = 0;
+size_t hostSdOpens = 0;
+
+// Whether the card still takes this change
+static bool written() {
+  if (hostSdWritesLeft == 0) {
+    return false;
+  }
+  if (hostSdWritesLeft > 0) {
+    --hostSdWritesLeft;
+  }
+  return true;
+}
+
+SdService::SdService() {}
+
+bool SdService::begin() { return sdCardMounted = true; }
+
+bool SdService::getSdState() { return sdCardMounted; }
+
+bool SdService::isFile(const std::string &filePath) {
+  return hostFiles.count(filePath) != 0;
+}
+
+bool SdService::ensureDirectory(const std::string &directory) { return true; }
+
+std::string SdService::readFile(const std::string &filePath) {
+  ++hostSdReads;
+  auto file = hostFiles.find(filePath);
+  return file == hostFiles.end() ? "" : file->second;
+}
+
+std::string SdService::readFileRange(const std::string &filePath,
+                                     size_t offset, size_t length) {
+  ++hostSdReads;
+  auto file = hostFiles.find(filePath);
+  if (file == hostFiles.end() || offset >= file->second.size()) {
+    return "";
+  }
+  return file->second.substr(offset, length);
+}
+
+size_t SdService::fileSize(const std::string &filePath) {
+  auto file = hostFiles.find(filePath);
+  return file == hostFiles.end() ? 0 : file->second.size();
+}
+
+bool SdService::writeFile(const std::string &filePath,
+                          const std::string &data) {
+  if (written()) {
+    hostFiles[filePath] = data;
+  }
+  return true;
+}
+
+bool SdService::appendToFile(const std::string &filePath,
+                             const std::string &data) {
+  if (written()) {
+    hostFiles[filePath] += data;
+  }
+  return true;
+}
+
+bool SdService::deleteFile(const std::string &filePath) {
+  if (written()) {
+    hostFiles.erase(filePath);
+  }
+  return true;
+}
+
+bool SdService::renameFile(const std::string &from, const std::string &to) {
+  if (written() && hostFiles.count(from)) {
+    hostFiles[to] = hostFiles[from];
+    hostFiles.erase(from);
+  }
+  return true;
+}
+
+File SdService::openFile(const std::string &filePath, const char *mode) {
+  ++hostSdOpens;
+  return File(filePath, mode);
+}
+
+File::File(const std::string &path, const char *mode) : path(path) {
+  if (mode[0] == 'r') {
+    open = hostFiles.count(path) != 0;
+    return;
+  }
+  open = written();
+  if (open && mode[0] == 'w') {
+    hostFiles[path].clear();
+  }
+  at = hostFiles[path].size();
+}
+
+size_t File::read(uint8_t *buffer, size_t size) {
+  ++hostSdReads;
+  const std::string &data = hostFiles[path];
+  size_t count = at < data.size() ? std::min(size, data.size() - at) : 0;
+  memcpy(buffer, data.data() + at, count);
+  at += count;
+  return count;
+}
+
+size_t File::write(const uint8_t *buffer, size_t size) {
+  if (!written()) {
+    return size;
+  }
+  std::string &data = hostFiles[path];
+  data.replace(at, std::min(size, data.size() - at), (const char *)buffer,
+               size);
+  at += size;
+  return size;
+}
+
+bool File::seek(uint32_t position) {
+  at = std::min((size_t)position, size());
+  return at == position;
+}
+
+size_t File::size() const {
+  auto file = hostFiles.find(path);
+  return file == hostFiles.end() ? 0 : file->second.size();
+}
@@ -0,0 +1,38 @@
+#ifndef TEST_H
+#define TEST_H
+
+#include <stdio.h>
+#include <vector>
+
+// A test is a function registered with TEST, CHECK records a failure and
+// carries on so one run shows every broken expectation
+struct TestCase
+{
+    const char *name;
+    void (*run)();
+};
+
+std::vector<TestCase> &testCases();
+extern int testFailures;
+
+struct TestRegistration
+{
+    TestRegistration(const char *name, void (*run)()) { testCases().push_back(TestCase{name, run}); }
+};
+
+#define TEST(name)                                              \
+    static void name();                                         \
+    static TestRegistration name##Registration(#name, name);    \
+    static void name()
+
+#define CHECK(condition)                                                        \
+    do                                                                          \
+    {                                                                           \
+        if (!(condition))                                                       \
+        {                                                                       \
+            printf("  %s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            ++testFailures;                                                     \
+        }                                                                       \
+    } while (0)
+
+#endif // TEST_H
@@ -0,0 +1,179 @@
+#include "appstate.h"
+#include "test.h"
+
+static const AppState STEPS[] = {STATE_STORAGE, STATE_CONFIG, STATE_WIFI,
+                                 STATE_ACCOUNT, STATE_ROOMS,  STATE_ROOM};
+
+TEST(appStateSuccessMovesOn) {
+  CHECK(afterStep(STATE_STORAGE, STATE_CONFIG, true, true) == STATE_CONFIG);
+  // the room list picks its own next step
+  CHECK(afterStep(STATE_ROOMS, STATE_ROOMS, true, true) == STATE_ROOMS);
+  CHECK(afterStep(STATE_ROOM, STATE_ROOMS, true, true) == STATE_ROOMS);
+}
+
+TEST(appStateRetryStays) {
+  for (AppState step : STEPS) {
+    CHECK(afterStep(step, STATE_ROOM, false, true) == step);
+  }
+}
+
+TEST(appStateBackGoesOneStepBack) {
+  CHECK(afterStep(STATE_CONFIG, STATE_WIFI, false, false) == STATE_STORAGE);
+  CHECK(afterStep(STATE_WIFI, STATE_ACCOUNT, false, false) == STATE_CONFIG);
+  CHECK(afterStep(STATE_ACCOUNT, STATE_ROOMS, false, false) == STATE_WIFI);
+  CHECK(afterStep(STATE_ROOMS, STATE_ROOM, false, false) == STATE_ACCOUNT);
+}
+
+TEST(appStateBackFromStorageRetries) {
+  CHECK(afterStep(STATE_STORAGE, STATE_CONFIG, false, false) == STATE_STORAGE);
+}
+
+TEST(appStateRecoversAfterFailures) {
+  // no SD card, then a failed login, a step back and on to a room
+  AppState state = STATE_STORAGE;
+  struct Step {
+    bool ok;
+    bool retry;
+  };
+  const Step script[] = {{false, true}, {true, true},   {true, true},
+                         {true, true},  {false, false}, {true, true},
+                         {true, true},  {true, true}};
+  for (const Step &step : script) {
+    state = afterStep(state, AppState(state + 1), step.ok, step.retry);
+  }
+  CHECK(state == STATE_ROOM);
+}
+
+// Steps that fail the way the board's do while what they need is missing.
+// Answers to RETRY / BACK come from `answers`, RETRY once they run out.
+struct ScriptedSteps : StartSteps {
+  bool card = true;
+  bool configValid = true;
+  bool wifi = true;
+  bool login = true;
+  bool rooms = true;
+  std::vector<bool> answers;
+  int calls[STATE_ROOM + 1] = {};
+  int asked = 0;
+  std::string why;
+
+  bool step(AppState state, bool ok, const char *failure) {
+    ++calls[state];
+    if (!ok) {
+      why = failure;
+    }
+    return ok;
+  }
+  bool startStorage() override {
+    return step(STATE_STORAGE, card, "No SD card!");
+  }
+  bool loadConfig() override {
+    return step(STATE_CONFIG, configValid, "Malformed config!");
+  }
+  bool startWifi() override { return step(STATE_WIFI, wifi, "No WiFi"); }
+  bool startAccount() override {
+    return step(STATE_ACCOUNT, login, "Log in fail");
+  }
+  bool chooseRoom(AppState &next) override {
+    next = STATE_ROOM;
+    return step(STATE_ROOMS, rooms, "Error getting rooms!");
+  }
+  void enterRoom() override { ++calls[STATE_ROOM]; }
+  bool retry() override {
+    bool answer = asked < (int)answers.size() ? answers[asked] : true;
+    ++asked;
+    return answer;
+  }
+  const std::string &failure() const override { return why; }
+};
+
+TEST(startStepsWaitForTheSdCard) {
+  ScriptedSteps steps;
+  steps.card = false;
+  steps.answers = {true, false}; // BACK has nothing before the SD card
+  AppState state = STATE_STORAGE;
+  state = runStep(steps, state);
+  state = runStep(steps, state);
+  CHECK(state == STATE_STORAGE);
+  CHECK(steps.why == "No SD card!");
+  CHECK(steps.calls[STATE_STORAGE] == 2);
+
+  steps.card = true;
+  state = runStep(steps, state);
+  CHECK(state == STATE_CONFIG);
+}
+
+TEST(startStepsMalformedConfigGoesBackToTheCard) {
+  ScriptedSteps steps;
+  steps.configValid = false;
+  steps.answers = {false};
+  AppState state = runStep(steps, STATE_STORAGE);
+  state = runStep(steps, state);
+  CHECK(steps.why == "Malformed config!");
+  CHECK(state == STATE_STORAGE);
+
+  // the config was fixed on another machine and the card put back
+  steps.configValid = true;
+  state = runStep(steps, state);
+  state = runStep(steps, state);
+  CHECK(state == STATE_WIFI);
+  CHECK(steps.calls[STATE_STORAGE] == 2);
+  CHECK(steps.calls[STATE_CONFIG] == 2);
+}
+
+TEST(startStepsLoginFailureRetriesThenGoesBack) {
+  ScriptedSteps steps;
+  steps.login = false;
+  steps.answers = {true, false};
+  AppState state = STATE_ACCOUNT;
+  state = runStep(steps, state);
+  CHECK(state == STATE_ACCOUNT);
+  state = runStep(steps, state);
+  CHECK(steps.why == "Log in fail");
+  CHECK(state == STATE_WIFI);
+
+  // another network, then the login works
+  steps.login = true;
+  state = runStep(steps, state);
+  state = runStep(steps, state);
+  CHECK(state == STATE_ROOMS);
+  CHECK(steps.calls[STATE_WIFI] == 1);
+  CHECK(steps.calls[STATE_ACCOUNT] == 3);
+}
+
+TEST(startStepsRoomListFailureGoesBackToTheAccount) {
+  ScriptedSteps steps;
+  steps.rooms = false;
+  steps.answers = {false};
+  AppState state = runStep(steps, STATE_ROOMS);
+  CHECK(steps.why == "Error getting rooms!");
+  CHECK(state == STATE_ACCOUNT);
+
+  steps.rooms = true;
+  state = runStep(steps, state);
+  state = runStep(steps, state);
+  CHECK(state == STATE_ROOM);
+  // leaving the room shows the list again
+  state = runStep(steps, state);
+  CHECK(state == STATE_ROOMS);
+  CHECK(steps.calls[STATE_ROOM] == 1);
+}
+
+TEST(startStepsRecoverFromEveryFailure) {
+  ScriptedSteps steps;
+  steps.card = steps.configValid = steps.wifi = steps.login = steps.rooms =
+      false;
+  AppState state = STATE_STORAGE;
+  // each failure is retried until what it needs appears, in boot order
+  bool *fixes[] = {&steps.card, &steps.configValid, &steps.wifi, &steps.login,
+                   &steps.rooms};
+  for (bool *fix : fixes) {
+    AppState failing = state;
+    state = runStep(steps, state);
+    CHECK(state == failing);
+    *fix = true;
+    state = runStep(steps, state);
+  }
+  CHECK(state == STATE_ROOM);
+  CHECK(steps.asked == 5); // once per failure, never after a success
+}
@@ -0,0 +1,112 @@
+#include "allocations.h"
+#include "arena.h"
+#include "fakes.h"
+#include "test.h"
+
+#include <string>
+
+#define RESET_CYCLES 500
+
+TEST(arenaGrowsTheLastBlockInPlace) {
+  Arena arena(256);
+  char *block = (char *)arena.allocate(16);
+  memcpy(block, "fifteen letters", 16);
+  size_t before = arena.highWater();
+
+  char *grown = (char *)arena.reallocate(block, 64);
+  CHECK(grown == block);
+  CHECK(strcmp(grown, "fifteen letters") == 0);
+  CHECK(arena.highWater() > before);
+
+  // and shrinks there too, handing the rest back
+  CHECK(arena.reallocate(grown, 8) == grown);
+  char *next = (char *)arena.allocate(8);
+  CHECK(next == grown + 16);
+}
+
+TEST(arenaMovesAnEarlierBlockToGrowIt) {
+  uint64_t overflows = hostCounters[COUNTER_ARENA_OVERFLOWS];
+  Arena arena(256);
+  char *first = (char *)arena.allocate(16);
+  memcpy(first, "fifteen letters", 16);
+  char *second = (char *)arena.allocate(16);
+
+  char *moved = (char *)arena.reallocate(first, 64);
+  CHECK(moved != first);
+  CHECK(moved > second); // still in the arena, after the last block
+  CHECK(strcmp(moved, "fifteen letters") == 0);
+  CHECK(hostCounters[COUNTER_ARENA_OVERFLOWS] == overflows);
+}
+
+TEST(arenaOverflowsToTheHeap) {
+  uint64_t overflows = hostCounters[COUNTER_ARENA_OVERFLOWS];
+  Arena arena(128);
+  char *small = (char *)arena.allocate(64);
+  char *large = (char *)arena.allocate(512);
+  CHECK(large != nullptr);
+  CHECK(hostCounters[COUNTER_ARENA_OVERFLOWS] == overflows + 1);
+  memset(large, 'x', 512);
+
+  // a heap block stays on the heap, an arena block that outgrows it moves
+  large = (char *)arena.reallocate(large, 1024);
+  CHECK(large != nullptr && large[511] == 'x');
+  memcpy(small, "kept", 5);
+  char *spilled = (char *)arena.reallocate(small, 256);
+  CHECK(strcmp(spilled, "kept") == 0);
+  CHECK(hostCounters[COUNTER_ARENA_OVERFLOWS] == overflows + 2);
+  arena.deallocate(large);
+  arena.deallocate(spilled);
+}
+
+TEST(arenaKeepsEarlierBlocksUntilReset) {
+  Arena arena(256);
+  char *first = (char *)arena.allocate(16);
+  char *second = (char *)arena.allocate(16);
+
+  // only the newest block goes back before a reset
+  arena.deallocate(first);
+  char *third = (char *)arena.allocate(16);
+  CHECK(third != first);
+  CHECK(third > second);
+  arena.deallocate(third);
+  CHECK(arena.allocate(16) == third);
+
+  arena.reset();
+  CHECK(arena.allocate(16) == first);
+}
+
+// What a poll does with the arena: parse an answer into a document that
+// allocates from it, read it, destroy the document and reset
+TEST(documentResetCyclesKeepTheHeapFlat) {
+  std::string body = "[";
+  for (int i = 0; i < 8; ++i) {
+    body += i ? "," : "";
+    body += "{\"author\":\"user" + std::to_string(i % 7) +
+            "\",\"content\":\"the weather meeting lunch code review " +
+            std::to_string(i) + "\",\"created\":\"2024-05-01 12:00\",\"id\":\"" +
+            std::to_string(i) + "\"}";
+  }
+  body += "]";
+
+  Arena arena;
+  uint64_t overflows = hostCounters[COUNTER_ARENA_OVERFLOWS];
+  size_t highWater = 0;
+  size_t allocations = 0;
+  for (int cycle = 0; cycle < RESET_CYCLES; ++cycle) {
+    if (cycle == 1) {
+      // the first cycle sets the level every later one must keep
+      highWater = arena.highWater();
+      allocations = hostAllocations;
+    }
+    {
+      JsonDocument doc(&arena);
+      CHECK(!deserializeJson(doc, body));
+      CHECK(doc.as<JsonArrayConst>().size() == 8);
+    }
+    arena.reset();
+  }
+  CHECK(highWater > 0);
+  CHECK(arena.highWater() == highWater);
+  CHECK(hostAllocations == allocations);
+  CHECK(hostCounters[COUNTER_ARENA_OVERFLOWS] == overflows);
+}
@@ -0,0 +1,67 @@
+#include "breaker.h"
+#include "telemetry.h"
+#include "test.h"
+
+#include <Arduino.h>
+
+static void failTimes(CircuitBreaker &breaker, int times) {
+  for (int i = 0; i < times; ++i) {
+    CHECK(breaker.allow());
+    breaker.failure();
+  }
+}
+
+TEST(breakerOpensAfterThreshold) {
+  hostMillis = 1000;
+  CircuitBreaker breaker;
+  failTimes(breaker, BREAKER_THRESHOLD - 1);
+  CHECK(breaker.state() == BREAKER_CLOSED);
+  failTimes(breaker, 1);
+  CHECK(breaker.state() == BREAKER_OPEN);
+  CHECK(!breaker.allow());
+  CHECK(telemetry.snapshot().breaker == BREAKER_OPEN);
+}
+
+TEST(breakerSuccessResetsTheCount) {
+  hostMillis = 1000;
+  CircuitBreaker breaker;
+  failTimes(breaker, BREAKER_THRESHOLD - 1);
+  breaker.success();
+  failTimes(breaker, BREAKER_THRESHOLD - 1);
+  CHECK(breaker.state() == BREAKER_CLOSED);
+}
+
+TEST(breakerProbesOnceAfterTheWait) {
+  hostMillis = 1000;
+  CircuitBreaker breaker;
+  failTimes(breaker, BREAKER_THRESHOLD);
+  uint32_t probeAt = telemetry.snapshot().probeAt;
+  // jittered within the last quarter of the wait
+  CHECK(probeAt >= 1000 + BREAKER_PROBE_MIN * 3 / 4);
+  CHECK(probeAt <= 1000 + BREAKER_PROBE_MIN);
+
+  hostMillis = probeAt;
+  CHECK(breaker.allow());
+  CHECK(breaker.state() == BREAKER_HALF_OPEN);
+  CHECK(!breaker.allow()); // one probe at a time
+  breaker.success();
+  CHECK(breaker.state() == BREAKER_CLOSED);
+  CHECK(breaker.allow());
+}
+
+TEST(breakerFailedProbeDoublesTheWait) {
+  hostMillis = 1000;
+  CircuitBreaker breaker;
+  failTimes(breaker, BREAKER_THRESHOLD);
+  uint32_t wait = BREAKER_PROBE_MIN;
+  for (int round = 0; round < 6; ++round) {
+    hostMillis = telemetry.snapshot().probeAt;
+    CHECK(breaker.allow());
+    unsigned long probed = hostMillis;
+    breaker.failure();
+    wait = wait * 2 > BREAKER_PROBE_MAX ? BREAKER_PROBE_MAX : wait * 2;
+    uint32_t probeAt = telemetry.snapshot().probeAt;
+    CHECK(probeAt > probed + wait * 3 / 4 - 1);
+    CHECK(probeAt <= probed + wait);
+  }
+}
@@ -0,0 +1,108 @@
+#include "inflate.h"
+#include "test.h"
+
+#include <string>
+#include <zlib.h>
+
+// Collects what the inflater writes
+class Collect : public Print {
+public:
+  size_t write(uint8_t c) override {
+    text += (char)c;
+    return 1;
+  }
+  size_t write(const uint8_t *buffer, size_t size) override {
+    text.append((const char *)buffer, size);
+    return size;
+  }
+  std::string text;
+};
+
+// `bits` 15 for zlib ("deflate"), 31 for gzip
+static std::string compress(const std::string &text, int bits) {
+  z_stream stream = z_stream();
+  deflateInit2(&stream, 9, Z_DEFLATED, bits, 8, Z_DEFAULT_STRATEGY);
+  std::string out(deflateBound(&stream, text.size()), '\0');
+  stream.next_in = (Bytef *)text.data();
+  stream.avail_in = text.size();
+  stream.next_out = (Bytef *)&out[0];
+  stream.avail_out = out.size();
+  deflate(&stream, Z_FINISH);
+  out.resize(stream.total_out);
+  deflateEnd(&stream);
+  return out;
+}
+
+// A /get answer of `count` messages, the kind of body that gets compressed
+static std::string history(size_t count) {
+  std::string text = "[";
+  for (size_t i = 0; i < count; ++i) {
+    text += i ? "," : "";
+    text += "\"{\\\"author\\\": \\\"user" + std::to_string(i % 7) +
+            "\\\", \\\"content\\\": \\\"message " + std::to_string(i * 7919) +
+            " about the weather\\\", \\\"created\\\": \\\"2024-05-0" +
+            std::to_string(i % 9 + 1) + "\\\", \\\"id\\\": \\\"" +
+            std::to_string(i) + "\\\"}\"";
+  }
+  return text + "]";
+}
+
+// Writes `body` in `chunk` byte pieces, as HTTPClient::writeToStream does
+static std::string inflate(const std::string &body, bool gzip, size_t chunk,
+                           bool &finished) {
+  InflateLease lease;
+  Collect out;
+  Inflater inflater(lease, out, gzip);
+  for (size_t at = 0; at < body.size(); at += chunk) {
+    size_t size = std::min(chunk, body.size() - at);
+    if (inflater.write((const uint8_t *)body.data() + at, size) != size) {
+      break; // what writeToStream does with a short write
+    }
+  }
+  finished = inflater.ok() && inflater.finished();
+  CHECK(!finished || inflater.compressedBytes() == body.size());
+  return out.text;
+}
+
+TEST(inflateLargeHistoryInSmallChunks) {
+  std::string text = history(1500);
+  CHECK(text.size() > 2 * TINFL_LZ_DICT_SIZE);
+  for (int bits : {15, 31}) {
+    std::string body = compress(text, bits);
+    for (size_t chunk : {1, 61, 1460}) {
+      bool finished = false;
+      CHECK(inflate(body, bits == 31, chunk, finished) == text);
+      CHECK(finished);
+    }
+  }
+}
+
+TEST(inflateDrainsTheWindowAfterTheLastChunk) {
+  // a few hundred bytes that expand past the whole window, so the last
+  // write ends with input used up and output still pending
+  std::string text(5 * TINFL_LZ_DICT_SIZE + 123, 'a');
+  std::string body = compress(text, 31);
+  CHECK(body.size() < 1024);
+  bool finished = false;
+  CHECK(inflate(body, true, body.size(), finished) == text);
+  CHECK(finished);
+  CHECK(inflate(body, true, 64, finished) == text);
+  CHECK(finished);
+}
+
+TEST(inflateTruncatedBodyIsNotFinished) {
+  std::string text = history(200);
+  std::string body = compress(text, 15);
+  body.resize(body.size() / 2);
+  bool finished = true;
+  inflate(body, false, 100, finished);
+  CHECK(!finished);
+}
+
+TEST(inflateRejectsABadGzipHeader) {
+  std::string body = compress(history(10), 31);
+  body[0] = 'x';
+  bool finished = true;
+  CHECK(inflate(body, true, 16, finished).empty());
+  CHECK(!finished);
+}
@@ -0,0 +1,70 @@
+#include "input.h"
+#include "lineeditor.h"
+#include "test.h"
+
+TEST(lineEditorInsertsAtTheCursor) {
+  LineEditor editor;
+  editor.insert("held");
+  editor.left();
+  editor.left();
+  editor.insert('l');
+  editor.insert('o');
+  CHECK(editor.text() == "helold");
+  CHECK(editor.cursor() == 4);
+}
+
+TEST(lineEditorKeepsToCodepoints) {
+  LineEditor editor;
+  editor.insert("a\xc3\xa9"); // a, e acute
+  editor.left();
+  CHECK(editor.cursor() == 1);
+  editor.right();
+  CHECK(editor.cursor() == 3);
+  editor.erase();
+  CHECK(editor.text() == "a");
+}
+
+TEST(lineEditorErasesForward) {
+  LineEditor editor;
+  editor.insert("\xe2\x82\xac" "b"); // euro sign, b
+  editor.set(editor.text());
+  editor.left();
+  editor.left();
+  editor.eraseForward();
+  CHECK(editor.text() == "b");
+}
+
+TEST(lineEditorMovesByWord) {
+  LineEditor editor;
+  editor.insert("one two  three");
+  editor.wordLeft();
+  CHECK(editor.cursor() == 9);
+  editor.wordLeft();
+  CHECK(editor.cursor() == 4);
+  editor.wordRight();
+  CHECK(editor.cursor() == 9);
+}
+
+TEST(lineEditorGrowsPastTheGap) {
+  LineEditor editor;
+  std::string text(EDITOR_GAP * 3 + 5, 'x');
+  editor.insert("ab");
+  editor.left();
+  editor.insert(text);
+  CHECK(editor.text() == "a" + text + "b");
+  CHECK(editor.slice(0, 2) == "ax");
+  CHECK(editor.at(editor.size() - 1) == 'b');
+}
+
+TEST(lineEditorHandlesKeys) {
+  LineEditor editor;
+  CHECK(editor.handle('h'));
+  CHECK(editor.handle(KEY_NEWLINE));
+  CHECK(editor.handle(KEY_ARROW_LEFT));
+  CHECK(editor.handle(KEY_DEL));
+  CHECK(!editor.handle(KEY_OK));
+  CHECK(editor.text() == "\n");
+  uint32_t revision = editor.revision();
+  editor.insert('x');
+  CHECK(editor.revision() != revision);
+}
@@ -0,0 +1,264 @@
+#include "allocations.h"
+#include "fakes.h"
+#include "fakeserver.h"
+#include "messagejar.h"
+#include "telemetry.h"
+#include "test.h"
+
+#define WARM_UP_POLLS 3
+#define STEADY_POLLS 50
+
+// Polls `polls` times the way the message task does, resetting the arena
+// after each, and returns the operator new calls they made
+static size_t pollAllocations(MessageJar &user, vector<Message> &out,
+                              Arena &arena, PollBuffers &buffers, int polls) {
+  size_t before = hostAllocations;
+  for (int i = 0; i < polls; ++i) {
+    CHECK(user.get_messages("general", 10, out, arena, buffers) ==
+          RESPONSE_OK);
+    arena.reset();
+  }
+  return hostAllocations - before;
+}
+
+TEST(serverBuildsEndpointUrlsOnce) {
+  Server server("https://jar.test/api/v1/");
+  CHECK(server.url() == "https://jar.test/api/v1");
+  CHECK(server.url(ENDPOINT_GET) == "https://jar.test/api/v1/get");
+  CHECK(server.url(ENDPOINT_SEND_BATCH) == "https://jar.test/api/v1/send/batch");
+}
+
+TEST(emptyPollsDoNotAllocate) {
+  fakeServer.reset();
+  fakeServer.always.body = "[]";
+  Server server("https://jar.test/api/v1");
+  MessageJar user(server, "token");
+  Arena arena;
+  PollBuffers buffers;
+  vector<Message> out;
+
+  // the first poll connects and sizes the buffers
+  pollAllocations(user, out, arena, buffers, WARM_UP_POLLS);
+  uint64_t overflows = hostCounters[COUNTER_ARENA_OVERFLOWS];
+  CHECK(pollAllocations(user, out, arena, buffers, STEADY_POLLS) == 0);
+  CHECK(hostCounters[COUNTER_ARENA_OVERFLOWS] == overflows);
+  CHECK(out.empty());
+  CHECK(fakeServer.connects == 1);
+  CHECK(fakeServer.lastUrl == "https://jar.test/api/v1/get");
+}
+
+TEST(pollsWithMessagesDoNotAllocate) {
+  fakeServer.reset();
+  // both forms the server uses, a JSON encoded string and an object
+  fakeServer.always.body =
+      "[\"{\\\"author\\\":\\\"ann\\\",\\\"content\\\":\\\"hi\\\","
+      "\\\"created\\\":\\\"12:00\\\",\\\"id\\\":\\\"11\\\"}\","
+      "{\"author\":\"bob\",\"content\":\"hello\",\"created\":\"12:01\","
+      "\"id\":\"12\"}]";
+  Server server("https://jar.test/api/v1");
+  MessageJar user(server, "token");
+  Arena arena;
+  PollBuffers buffers;
+  vector<Message> out;
+
+  // short fields stay within std::string, `out` keeps its capacity
+  pollAllocations(user, out, arena, buffers, WARM_UP_POLLS);
+  uint64_t overflows = hostCounters[COUNTER_ARENA_OVERFLOWS];
+  CHECK(pollAllocations(user, out, arena, buffers, STEADY_POLLS) == 0);
+  CHECK(hostCounters[COUNTER_ARENA_OVERFLOWS] == overflows);
+  CHECK(out.size() == 2);
+  CHECK(out.size() == 2 && out[0].as_string() == "ann: hi\n");
+  CHECK(out.size() == 2 && out[1].as_string() == "bob: hello\n");
+}
+
+#define FUZZ_ROUNDS 20000
+
+// Answers the server gives, the fuzz loop mutates them
+static const char *const FUZZ_SEEDS[] = {
+    "[]",
+    "[\"{\\\"author\\\":\\\"ann\\\",\\\"content\\\":\\\"hi\\\",\\\"created\\\":"
+    "\\\"12:00\\\",\\\"id\\\":\\\"11\\\"}\"]",
+    "[{\"author\":\"bob\",\"content\":\"caf\\u00e9 \\ud83d\\ude00\","
+    "\"created\":\"12:01\",\"id\":12}]",
+    "{\"e\":\"Bad token!\"}",
+    "{\"token\":\"0123456789abcdef\"}",
+    "{\"exists\":true}",
+    "true",
+    "[[[[[[[[[[[[[[[[[[[[1]]]]]]]]]]]]]]]]]]]]",
+    "<html><body>502 Bad Gateway</body></html>",
+    "",
+};
+
+// Deterministic, so a failure can be replayed
+static uint32_t fuzzRandom(uint32_t &state) {
+  state = state * 1664525 + 1013904223;
+  return state >> 8;
+}
+
+// Truncates, reorders, overwrites with binary or repeats a part of `body`
+static void mutate(string &body, uint32_t &state) {
+  size_t size = body.size();
+  size_t at = size ? fuzzRandom(state) % size : 0;
+  size_t length = size ? fuzzRandom(state) % (size - at + 1) : 0;
+  switch (fuzzRandom(state) % 4) {
+  case 0:
+    body.resize(at);
+    break;
+  case 1:
+    body = body.substr(at, length) + body.substr(0, at) +
+           body.substr(at + length);
+    break;
+  case 2:
+    for (size_t i = 0; i < length; ++i) {
+      body[at + i] = (char)fuzzRandom(state);
+    }
+    if (!length) {
+      body.insert(at, 1, (char)fuzzRandom(state));
+    }
+    break;
+  default:
+    body.insert(at, body.substr(at, length));
+    break;
+  }
+}
+
+TEST(decodeResponseSurvivesMangledBodies) {
+  static const int CODES[] = {200, 204, 400, 401, 404, 500, 503};
+  Arena arena;
+  uint32_t state = 46;
+  string error;
+  for (int round = 0; round < FUZZ_ROUNDS; ++round) {
+    string body = FUZZ_SEEDS[round % (sizeof(FUZZ_SEEDS) / sizeof(*FUZZ_SEEDS))];
+    for (uint32_t n = fuzzRandom(state) % 4 + 1; n; --n) {
+      mutate(body, state);
+    }
+    bool delivered = fuzzRandom(state) % 8 != 0;
+    int code = CODES[fuzzRandom(state) % (sizeof(CODES) / sizeof(*CODES))];
+    bool needsBody = fuzzRandom(state) % 2;
+
+    error.clear();
+    ResponseStatus status;
+    {
+      JsonDocument doc(&arena);
+      status = decode_response(delivered, code, body, doc, needsBody, &error);
+    }
+    arena.reset();
+
+    bool known = status == RESPONSE_OK || status == RESPONSE_API_ERROR ||
+                 status == RESPONSE_TRANSPORT_ERROR;
+    // the statuses still follow classify_response's rules
+    bool consistent =
+        (delivered || status == RESPONSE_TRANSPORT_ERROR) &&
+        (!delivered || (code >= 200 && code < 300) ||
+         status == RESPONSE_API_ERROR) &&
+        (status != RESPONSE_API_ERROR || !error.empty());
+    CHECK(known && consistent);
+    if (!known || !consistent) {
+      printf("  round %d, code %d: %s\n", round, code, body.c_str());
+      break;
+    }
+  }
+}
+
+TEST(pollsSurviveMangledBodies) {
+  fakeServer.reset();
+  Server server("https://jar.test/api/v1");
+  MessageJar user(server, "token");
+  Arena arena;
+  PollBuffers buffers;
+  vector<Message> out;
+  uint32_t state = 32;
+  for (int round = 0; round < FUZZ_ROUNDS / 10; ++round) {
+    string body = FUZZ_SEEDS[round % 3];
+    mutate(body, state);
+    fakeServer.always.body = body;
+    ResponseStatus status =
+        user.get_messages("general", 10, out, arena, buffers);
+    arena.reset();
+    CHECK(status == RESPONSE_OK || status == RESPONSE_API_ERROR ||
+          status == RESPONSE_TRANSPORT_ERROR);
+    CHECK(status == RESPONSE_OK || out.empty());
+    // an open breaker would skip the parsing this is here for
+    server.breaker.success();
+  }
+}
+
+// A call goes through the faults its retries allow, rooms/list has two.
+// Each call starts on a new connection, request() itself tries once more
+// when a kept one was dropped.
+TEST(exchangeRetriesThroughFaults) {
+  fakeServer.reset();
+  hostMillis = 1000;
+  Server server("https://jar.test/api/v1");
+  MessageJar user(server, "token");
+  uint64_t retries = hostCounters[COUNTER_RETRIES];
+
+  fakeServer.script(FAULT_TIMEOUT);
+  fakeServer.script(503, "<html>Service Unavailable</html>");
+  fakeServer.script(200, "[\"general\"]");
+  auto rooms = user.get_rooms();
+  CHECK(rooms && rooms->size() == 1);
+  CHECK(fakeServer.requests == 3);
+
+  fakeServer.dropConnections();
+  fakeServer.script(FAULT_RESET);
+  fakeServer.script(FAULT_TIMEOUT);
+  CHECK(user.get_rooms() != nullptr);
+  CHECK(fakeServer.requests == 6);
+  CHECK(hostCounters[COUNTER_RETRIES] == retries + 4);
+
+  // one fault too many fails the call
+  fakeServer.dropConnections();
+  fakeServer.script(FAULT_RESET);
+  fakeServer.script(FAULT_TIMEOUT);
+  fakeServer.script(503, "");
+  CHECK(user.get_rooms() == nullptr);
+  CHECK(fakeServer.requests == 9);
+  CHECK(server.breaker.state() == BREAKER_CLOSED);
+}
+
+TEST(breakerCountsCallsNotAttempts) {
+  fakeServer.reset();
+  hostMillis = 1000;
+  fakeServer.always = FakeAnswer{503, "", FAULT_NONE, ""};
+  Server server("https://jar.test/api/v1");
+  MessageJar user(server, "token");
+
+  for (int i = 0; i < BREAKER_THRESHOLD - 1; ++i) {
+    CHECK(user.get_rooms() == nullptr);
+  }
+  CHECK(server.breaker.state() == BREAKER_CLOSED);
+  CHECK(fakeServer.requests == 3 * (BREAKER_THRESHOLD - 1));
+  CHECK(user.get_rooms() == nullptr);
+  CHECK(server.breaker.state() == BREAKER_OPEN);
+
+  // open, calls fail without a request
+  uint64_t rejects = hostCounters[COUNTER_BREAKER_REJECTS];
+  size_t requests = fakeServer.requests;
+  CHECK(user.get_rooms() == nullptr);
+  CHECK(fakeServer.requests == requests);
+  CHECK(hostCounters[COUNTER_BREAKER_REJECTS] == rejects + 1);
+}
+
+TEST(breakerProbeUsesItsRetries) {
+  fakeServer.reset();
+  hostMillis = 1000;
+  fakeServer.always = FakeAnswer{503, "", FAULT_NONE, ""};
+  Server server("https://jar.test/api/v1");
+  MessageJar user(server, "token");
+  for (int i = 0; i < BREAKER_THRESHOLD; ++i) {
+    user.get_rooms();
+  }
+  CHECK(server.breaker.state() == BREAKER_OPEN);
+
+  // the probe meets a reset and a timeout before the server is back
+  hostMillis = telemetry.snapshot().probeAt;
+  fakeServer.always = FakeAnswer{200, "[]", FAULT_NONE, ""};
+  fakeServer.dropConnections();
+  fakeServer.script(FAULT_RESET);
+  fakeServer.script(FAULT_TIMEOUT);
+  size_t requests = fakeServer.requests;
+  CHECK(user.get_rooms() != nullptr);
+  CHECK(fakeServer.requests == requests + 3);
+  CHECK(server.breaker.state() == BREAKER_CLOSED);
+}
@@ -0,0 +1,131 @@
+#include "outboxbatch.h"
+#include "test.h"
+
+// Answers sends the way it is told to and records every request
+struct FakeUser {
+  bool offersBatch = true;
+  ResponseStatus batchAnswer = RESPONSE_OK;
+  bool batchNotFound = false; // an older server, batching turns off
+  // answers for single sends, RESPONSE_OK with code 200 past the end
+  vector<std::pair<ResponseStatus, int>> answers;
+
+  size_t batches = 0;
+  vector<string> sent;
+
+  bool batching() const { return offersBatch; }
+
+  ResponseStatus send_batch(const vector<std::pair<string, string>> &messages) {
+    ++batches;
+    if (batchNotFound) {
+      offersBatch = false;
+      return RESPONSE_TRANSPORT_ERROR;
+    }
+    return batchAnswer;
+  }
+
+  ResponseStatus send(const string &room, const string &message, int *code) {
+    size_t i = sent.size();
+    sent.push_back(message);
+    *code = i < answers.size() ? answers[i].second : 200;
+    return i < answers.size() ? answers[i].first : RESPONSE_OK;
+  }
+};
+
+struct Delivery {
+  size_t acknowledged = 0;
+  vector<uint32_t> parked;
+  bool ok = false;
+};
+
+static vector<OutboxEntry> entries(size_t count) {
+  vector<OutboxEntry> batch;
+  for (uint32_t i = 1; i <= count; ++i) {
+    batch.push_back(OutboxEntry{i, "room", "message " + std::to_string(i)});
+  }
+  return batch;
+}
+
+static Delivery deliver(FakeUser &user, const vector<OutboxEntry> &batch) {
+  std::mutex userMutex;
+  Delivery result;
+  result.ok = deliverBatch(
+      user, userMutex, batch,
+      [&](size_t count) { result.acknowledged += count; },
+      [&](const OutboxEntry &entry) { result.parked.push_back(entry.seq); });
+  return result;
+}
+
+TEST(outboxSendsOneBatch) {
+  FakeUser user;
+  Delivery result = deliver(user, entries(5));
+  CHECK(result.ok);
+  CHECK(user.batches == 1);
+  CHECK(user.sent.empty());
+  CHECK(result.acknowledged == 5);
+}
+
+TEST(outboxSingleMessageSkipsTheBatch) {
+  FakeUser user;
+  Delivery result = deliver(user, entries(1));
+  CHECK(result.ok && user.batches == 0 && user.sent.size() == 1);
+}
+
+TEST(outboxStopsWhenTheBatchIsNotDelivered) {
+  FakeUser user;
+  user.batchAnswer = RESPONSE_TRANSPORT_ERROR;
+  Delivery result = deliver(user, entries(5));
+  CHECK(!result.ok);
+  CHECK(user.sent.empty());
+  CHECK(result.acknowledged == 0);
+}
+
+TEST(outboxFallsBackWithoutBatchEndpoint) {
+  FakeUser user;
+  user.batchNotFound = true;
+  Delivery result = deliver(user, entries(3));
+  CHECK(result.ok);
+  CHECK(user.sent.size() == 3);
+  CHECK(result.acknowledged == 3);
+
+  // later batches go one by one without asking again
+  Delivery next = deliver(user, entries(2));
+  CHECK(next.ok && user.batches == 1 && user.sent.size() == 5);
+}
+
+TEST(outboxRejectedBatchCostsOneExtraRequest) {
+  FakeUser user;
+  user.batchAnswer = RESPONSE_API_ERROR;
+  user.answers = {{RESPONSE_OK, 200},
+                  {RESPONSE_API_ERROR, 400},
+                  {RESPONSE_OK, 200},
+                  {RESPONSE_OK, 200}};
+  Delivery result = deliver(user, entries(4));
+  CHECK(result.ok);
+  CHECK(user.batches == 1);
+  CHECK(user.sent.size() == 4); // the rest of the batch, each once
+  CHECK(result.parked == vector<uint32_t>{2});
+  CHECK(result.acknowledged == 4);
+}
+
+TEST(outboxKeepsMessagesOnErrorsNotAboutThem) {
+  const int codes[] = {401, 403, 408, 429};
+  for (int code : codes) {
+    FakeUser user;
+    user.answers = {{RESPONSE_OK, 200}, {RESPONSE_API_ERROR, code}};
+    user.offersBatch = false;
+    Delivery result = deliver(user, entries(3));
+    CHECK(!result.ok);
+    CHECK(result.parked.empty());
+    CHECK(result.acknowledged == 1); // the second stays at the front
+  }
+}
+
+TEST(outboxStopsOnTransportErrorMidway) {
+  FakeUser user;
+  user.offersBatch = false;
+  user.answers = {{RESPONSE_OK, 200}, {RESPONSE_TRANSPORT_ERROR, 0}};
+  Delivery result = deliver(user, entries(3));
+  CHECK(!result.ok);
+  CHECK(user.sent.size() == 2);
+  CHECK(result.acknowledged == 1);
+}
@@ -0,0 +1,251 @@
+#include "fakes.h"
+#include "fakeserver.h"
+#include "outbox.h"
+#include "test.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+static const string JOURNAL = string(HISTORY_DIR) + OUTBOX_FILE;
+static const string ACK = string(HISTORY_DIR) + OUTBOX_ACK_FILE;
+static const string PARKED = string(HISTORY_DIR) + OUTBOX_PARKED_FILE;
+
+// A server that takes every message but those containing "bad", and a batch
+// only when it holds none of them. `accepted` gets what it took, in order.
+static void acceptMessages(vector<string> &accepted) {
+  fakeServer.respond = [&accepted](const std::string &body) {
+    JsonDocument doc;
+    deserializeJson(doc, body);
+    vector<string> messages;
+    if (doc["messages"].is<JsonArrayConst>()) {
+      for (JsonVariant entry : doc["messages"].as<JsonArrayConst>()) {
+        messages.push_back(entry["message"].as<string>());
+      }
+    } else {
+      messages.push_back(doc["message"].as<string>());
+    }
+    for (const string &message : messages) {
+      if (message.find("bad") != string::npos) {
+        return FakeAnswer{400, "{\"e\":\"rejected\"}", FAULT_NONE, ""};
+      }
+    }
+    accepted.insert(accepted.end(), messages.begin(), messages.end());
+    return FakeAnswer{200, "", FAULT_NONE, ""};
+  };
+}
+
+static size_t occurrences(const string &text, const string &part) {
+  size_t count = 0;
+  for (size_t at = text.find(part); at != string::npos;
+       at = text.find(part, at + 1)) {
+    ++count;
+  }
+  return count;
+}
+
+static void startOver() {
+  hostFiles.clear();
+  hostSdWritesLeft = -1;
+  hostMillis = 1000;
+  fakeServer.reset();
+}
+
+TEST(outboxKeepsItsPlaceAcrossALinkDrop) {
+  startOver();
+  vector<string> accepted;
+  acceptMessages(accepted);
+  SdService sd;
+  Server server("https://jar.test/api/v1");
+  MessageJar user(server, "token");
+  std::mutex userMutex;
+
+  // queued while the link is down
+  Outbox outbox(sd);
+  outbox.load();
+  fakeServer.refuseConnects = true;
+  for (int i = 0; i < 25; ++i) {
+    outbox.enqueue("general", "m" + std::to_string(i));
+  }
+  CHECK(outbox.flush(&user, userMutex) == 25);
+  CHECK(!hostFiles.count(ACK));
+
+  // back for one batch, then gone again
+  fakeServer.refuseConnects = false;
+  auto accept = fakeServer.respond;
+  fakeServer.respond = [&](const std::string &body) {
+    FakeAnswer answer = accept(body);
+    fakeServer.refuseConnects = true;
+    fakeServer.dropConnections();
+    return answer;
+  };
+  hostMillis += OUTBOX_RETRY;
+  CHECK(outbox.flush(&user, userMutex) == 25 - OUTBOX_BATCH);
+  CHECK(hostFiles[ACK] == std::to_string(OUTBOX_BATCH));
+
+  // a reboot picks up where the ack file says
+  Outbox rebooted(sd);
+  rebooted.load();
+  CHECK(rebooted.pending() == 25 - OUTBOX_BATCH);
+
+  fakeServer.refuseConnects = false;
+  fakeServer.respond = accept;
+  CHECK(rebooted.flush(&user, userMutex) == 0);
+  CHECK(!hostFiles.count(JOURNAL));
+  CHECK(accepted.size() == 25);
+  for (size_t i = 0; i < accepted.size(); ++i) {
+    CHECK(accepted[i] == "m" + std::to_string(i));
+  }
+
+  // numbering goes on after the journal started over
+  Outbox again(sd);
+  again.load();
+  CHECK(again.pending() == 0);
+  again.enqueue("general", "later");
+  CHECK(hostFiles[JOURNAL].find("\"seq\":26") != string::npos);
+}
+
+TEST(outboxSkipsATornJournalLine) {
+  startOver();
+  SdService sd;
+  hostFiles[JOURNAL] =
+      "{\"seq\":1,\"room\":\"general\",\"message\":\"first\"}\n"
+      "{\"seq\":2,\"room\":\"general\",\"mess";
+
+  Outbox outbox(sd);
+  outbox.load();
+  CHECK(outbox.pending() == 1);
+  outbox.enqueue("general", "second");
+
+  // the entry after the torn line is whole, and survives the next reboot
+  Outbox rebooted(sd);
+  rebooted.load();
+  CHECK(rebooted.pending() == 2);
+
+  vector<string> accepted;
+  acceptMessages(accepted);
+  Server server("https://jar.test/api/v1");
+  MessageJar user(server, "token");
+  std::mutex userMutex;
+  CHECK(rebooted.flush(&user, userMutex) == 0);
+  CHECK(accepted.size() == 2);
+  CHECK(accepted.size() == 2 && accepted[0] == "first");
+  CHECK(accepted.size() == 2 && accepted[1] == "second");
+}
+
+// Cuts the power after each number of SD writes a flush makes, one message
+// of the three is rejected, then reboots and flushes again
+TEST(outboxSurvivesACrashAtEveryWrite) {
+  int before = testFailures;
+  for (int writes = 0; writes <= 6; ++writes) {
+    startOver();
+    vector<string> accepted;
+    acceptMessages(accepted);
+    SdService sd;
+    Server server("https://jar.test/api/v1");
+    MessageJar user(server, "token");
+    std::mutex userMutex;
+
+    Outbox outbox(sd);
+    outbox.load();
+    outbox.enqueue("general", "one");
+    outbox.enqueue("general", "bad two");
+    outbox.enqueue("general", "three");
+    hostSdWritesLeft = writes;
+    outbox.flush(&user, userMutex);
+
+    hostSdWritesLeft = -1;
+    Outbox rebooted(sd);
+    rebooted.load();
+    CHECK(rebooted.flush(&user, userMutex) == 0);
+
+    // nothing lost, the rejected one parked once and never sent on
+    CHECK(std::count(accepted.begin(), accepted.end(), "one") >= 1);
+    CHECK(std::count(accepted.begin(), accepted.end(), "three") >= 1);
+    CHECK(std::count(accepted.begin(), accepted.end(), "bad two") == 0);
+    CHECK(occurrences(hostFiles[PARKED], "bad two") == 1);
+
+    Outbox again(sd);
+    again.load();
+    CHECK(again.pending() == 0);
+    if (testFailures != before) {
+      printf("  after %d writes\n", writes);
+      break;
+    }
+  }
+}
+
+TEST(outboxCoalescesABurstIntoOneRequest) {
+  startOver();
+  vector<string> accepted;
+  acceptMessages(accepted);
+  SdService sd;
+  Server server("https://jar.test/api/v1");
+  MessageJar user(server, "token");
+  std::mutex userMutex;
+  Outbox outbox(sd);
+  outbox.load();
+  CHECK(!outbox.waitForFlush(0));
+
+  // a pasted block of lines, queued over a few milliseconds
+  outbox.enqueue("general", "line 0");
+  CHECK(!outbox.waitForFlush(0));
+  for (int i = 1; i < 10; ++i) {
+    hostMillis += OUTBOX_COALESCE / 10;
+    outbox.enqueue("general", "line " + std::to_string(i));
+  }
+  CHECK(!outbox.waitForFlush(0));
+  hostMillis += OUTBOX_COALESCE - 9 * (OUTBOX_COALESCE / 10);
+  CHECK(outbox.waitForFlush(0));
+  CHECK(outbox.flush(&user, userMutex) == 0);
+  CHECK(fakeServer.requests == 1);
+  CHECK(accepted.size() == 10);
+
+  // the next message waits out a window of its own
+  outbox.enqueue("general", "later");
+  CHECK(!outbox.waitForFlush(0));
+  hostMillis += OUTBOX_COALESCE;
+  CHECK(outbox.waitForFlush(0));
+}
+
+TEST(outboxWaitsOutTheRetryAfterAFailure) {
+  startOver();
+  SdService sd;
+  Server server("https://jar.test/api/v1");
+  MessageJar user(server, "token");
+  std::mutex userMutex;
+  Outbox outbox(sd);
+  outbox.load();
+  fakeServer.refuseConnects = true;
+  outbox.enqueue("general", "one");
+  hostMillis += OUTBOX_COALESCE;
+  CHECK(outbox.flush(&user, userMutex) == 1);
+  CHECK(outbox.stalled());
+
+  // more typed meanwhile does not bring the retry forward
+  outbox.enqueue("general", "two");
+  hostMillis += OUTBOX_RETRY - 1;
+  CHECK(!outbox.waitForFlush(0));
+  hostMillis += 1;
+  CHECK(outbox.waitForFlush(0));
+
+  // queued before a reboot, sent right after it
+  Outbox rebooted(sd);
+  rebooted.load();
+  CHECK(rebooted.pending() == 2);
+  CHECK(rebooted.waitForFlush(0));
+}
+
+TEST(outboxEnqueueWakesTheSender) {
+  startOver();
+  SdService sd;
+  Outbox outbox(sd);
+  outbox.load();
+
+  auto start = std::chrono::steady_clock::now();
+  std::thread sender([&outbox]() { outbox.waitForFlush(60000); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  outbox.enqueue("general", "one");
+  sender.join();
+  CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(10));
+}
@@ -0,0 +1,57 @@
+#include "requestbody.h"
+#include "test.h"
+
+#include <string>
+
+static std::string text(const RequestBody &body) {
+  return std::string((const char *)body.data(), body.size());
+}
+
+constexpr const char *FIELDS[] = {"token", "room", "latest"};
+
+TEST(requestBodyBuildsFieldsInOrder) {
+  RequestBody body;
+  body.build(bodyFields(FIELDS), {"t", std::string("lobby"), (uint32_t)42});
+  CHECK(text(body) == "{\"token\":\"t\",\"room\":\"lobby\",\"latest\":42}");
+}
+
+TEST(requestBodyLeavesOutMissingAndExtraValues) {
+  RequestBody body;
+  body.build(bodyFields(FIELDS), {"t"});
+  CHECK(text(body) == "{\"token\":\"t\"}");
+  body.build(bodyFields(FIELDS), {"a", "b", (uint32_t)1, "extra"});
+  CHECK(text(body) == "{\"token\":\"a\",\"room\":\"b\",\"latest\":1}");
+}
+
+TEST(requestBodyEscapesStrings) {
+  RequestBody body;
+  body.quoted("a\"b\\c\nd\x01", 8);
+  CHECK(text(body) == "\"a\\\"b\\\\c\\nd\\u0001\"");
+}
+
+TEST(requestBodyPassesUtf8Through) {
+  RequestBody body;
+  std::string word = "h\xc3\xa9llo";
+  body.quoted(word.data(), word.size());
+  CHECK(text(body) == "\"" + word + "\"");
+}
+
+TEST(requestBodySpillsPastTheBuffer) {
+  RequestBody body;
+  std::string longText(REQUEST_BODY_SIZE * 2, 'x');
+  body.build(bodyFields(FIELDS), {"t", longText});
+  CHECK(text(body) == "{\"token\":\"t\",\"room\":\"" + longText + "\"}");
+
+  // back in the fixed buffer for the next one
+  body.build(bodyFields(FIELDS), {"t"});
+  CHECK(text(body) == "{\"token\":\"t\"}");
+}
+
+TEST(requestBodyEmptyAfterClear) {
+  RequestBody body;
+  body.raw("abc");
+  body.clear();
+  CHECK(body.size() == 0);
+  body.raw("");
+  CHECK(body.size() == 0);
+}
@@ -0,0 +1,36 @@
+#include "response.h"
+#include "test.h"
+
+TEST(responseUndeliveredIsTransportError) {
+  CHECK(classify_response(false, 200, true, false, true) ==
+        RESPONSE_TRANSPORT_ERROR);
+  CHECK(classify_response(false, 0, false, false, false) ==
+        RESPONSE_TRANSPORT_ERROR);
+}
+
+TEST(responseSuccessNeeds2xx) {
+  CHECK(classify_response(true, 200, true, false, true) == RESPONSE_OK);
+  CHECK(classify_response(true, 204, false, false, false) == RESPONSE_OK);
+  CHECK(classify_response(true, 301, true, false, true) == RESPONSE_API_ERROR);
+}
+
+TEST(responseErrorPagesAreApiErrors) {
+  // an HTML 401, 404 or 413 must never count as a delivered message
+  CHECK(classify_response(true, 401, false, false, false) ==
+        RESPONSE_API_ERROR);
+  CHECK(classify_response(true, 404, false, false, false) ==
+        RESPONSE_API_ERROR);
+  CHECK(classify_response(true, 413, false, false, true) == RESPONSE_API_ERROR);
+}
+
+TEST(responseErrorObjectIsApiError) {
+  CHECK(classify_response(true, 200, true, true, false) == RESPONSE_API_ERROR);
+  CHECK(classify_response(true, 400, true, true, true) == RESPONSE_API_ERROR);
+}
+
+TEST(responseUnparseableBody) {
+  // fine where the endpoint sends none, broken where it promised one
+  CHECK(classify_response(true, 200, false, false, false) == RESPONSE_OK);
+  CHECK(classify_response(true, 200, false, false, true) ==
+        RESPONSE_TRANSPORT_ERROR);
+}
@@ -0,0 +1,61 @@
+#include "fakes.h"
+#include "search.h"
+#include "test.h"
+
+static string fixtureLog(int lines) {
+  string log;
+  for (int i = 0; i < lines; ++i) {
+    log += "user" + std::to_string(i % 7) + ": line " + std::to_string(i) +
+           (i == lines - 2 ? " needle" : " hay") + "\n";
+  }
+  return log;
+}
+
+TEST(searchCatchesUpInBoundedSteps) {
+  hostFiles.clear();
+  SdService sd;
+  sd.begin();
+  History history(sd);
+  SearchIndex index(sd, history);
+  string log = fixtureLog(400);
+  hostFiles[history.path("room", ".log")] = log;
+
+  int steps = 1;
+  while (!index.catchUp("room", HISTORY_PAGE)) {
+    ++steps;
+  }
+  CHECK(steps > 1);
+
+  // nothing left for the search to index
+  bool indexing = false;
+  vector<SearchHit> hits = index.search(
+      "room", "needle", [&](size_t done, size_t total) { indexing = true; });
+  CHECK(!indexing);
+  CHECK(hits.size() == 1);
+  CHECK(hits.size() == 1 && hits[0].text == "user6: line 398 needle");
+}
+
+TEST(searchReportsIndexingProgress) {
+  hostFiles.clear();
+  SdService sd;
+  sd.begin();
+  History history(sd);
+  SearchIndex index(sd, history);
+  string log = fixtureLog(400);
+  hostFiles[history.path("room", ".log")] = log;
+
+  size_t calls = 0;
+  size_t lastDone = 0;
+  size_t lastTotal = 0;
+  vector<SearchHit> hits =
+      index.search("room", "needle", [&](size_t done, size_t total) {
+        CHECK(done > lastDone);
+        ++calls;
+        lastDone = done;
+        lastTotal = total;
+      });
+  CHECK(calls > 1);
+  CHECK(lastDone == log.size() && lastTotal == log.size());
+  CHECK(hits.size() == 1);
+  CHECK(index.catchUp("room", HISTORY_PAGE));
+}
@@ -0,0 +1,112 @@
+#include "fakes.h"
+#include "test.h"
+#include "textlayout.h"
+
+// Checks that `spans` cover `text` in order, each row within `maxWidth`, and
+// that only the spaces the rows broke on are left out
+static bool coversLine(TextLayout &layout, const string &text,
+                       const vector<LineSpan> &spans, int32_t maxWidth) {
+  size_t next = 0;
+  for (const LineSpan &span : spans) {
+    if (span.start != next && !(span.start == next + 1 && text[next] == ' ')) {
+      return false;
+    }
+    if (layout.width(text.data() + span.start, span.length) > maxWidth) {
+      return false;
+    }
+    next = span.start + span.length;
+  }
+  return next == text.size();
+}
+
+TEST(layoutWrapsOnSpaces) {
+  TextLayout layout;
+  layout.setTextSize(1);
+  string text = "the quick brown fox jumps";
+  const vector<LineSpan> &spans = layout.wrap(text.data(), text.size(), 60);
+  CHECK(spans.size() == 3);
+  CHECK(coversLine(layout, text, spans, 60));
+  CHECK(spans.size() == 3 && text.substr(spans[1].start, spans[1].length) == "brown fox");
+}
+
+TEST(layoutWrapsALineLongerThan64K) {
+  TextLayout layout;
+  layout.setTextSize(1);
+  string text;
+  while (text.size() < 70000) {
+    text += "word ";
+  }
+  text += "end";
+  const vector<LineSpan> &spans = layout.wrap(text.data(), text.size(), 240);
+  CHECK(coversLine(layout, text, spans, 240));
+  CHECK(spans.back().start > 65535);
+  CHECK(text.substr(spans.back().start, spans.back().length).find("end") != string::npos);
+
+  // one word with no space to break on
+  string word(70000, 'x');
+  const vector<LineSpan> &hard = layout.wrap(word.data(), word.size(), 240);
+  CHECK(hard.size() == 70000 / 40);
+  CHECK(coversLine(layout, word, hard, 240));
+}
+
+static void packFont(const char *path) {
+  vector<uint32_t> codepoints;
+  for (uint32_t c = 0xc0; c < 0x100; ++c) {
+    codepoints.push_back(c);
+  }
+  for (uint32_t c = 0x4e00; c < 0x4e40; ++c) {
+    codepoints.push_back(c);
+  }
+  hostFiles[path] = hostFont(10, codepoints);
+}
+
+TEST(glyphCacheKeepsTheFontOpen) {
+  hostFiles.clear();
+  packFont("/font.bin");
+  SdService sd;
+  GlyphCache glyphs(sd, "/font.bin");
+  size_t opens = hostSdOpens;
+  CHECK(glyphs.begin());
+  CHECK(glyphs.height() == 10);
+
+  for (uint32_t c = 0x4e00; c < 0x4e40; ++c) {
+    CHECK(glyphs.get(c).width == 8);
+  }
+  CHECK(glyphs.get(0xe9).width == 6);
+  CHECK(glyphs.get(0xe9).bits.size() == 10);
+  CHECK(glyphs.get(0x1f600).width == 0); // not in the font
+  CHECK(hostSdOpens == opens + 1);
+}
+
+TEST(glyphCacheReopensTheFontAfterAFailedRead) {
+  hostFiles.clear();
+  packFont("/font.bin");
+  SdService sd;
+  GlyphCache glyphs(sd, "/font.bin");
+  CHECK(glyphs.begin());
+  size_t opens = hostSdOpens;
+
+  // the card goes away and comes back
+  string font = hostFiles["/font.bin"];
+  hostFiles.erase("/font.bin");
+  CHECK(glyphs.get(0x4e01).width == 0);
+  hostFiles["/font.bin"] = font;
+  CHECK(glyphs.get(0x4e02).width == 8);
+  CHECK(glyphs.get(0x4e03).width == 8);
+  CHECK(hostSdOpens == opens + 1);
+}
+
+TEST(layoutMeasuresGlyphsFromTheFont) {
+  hostFiles.clear();
+  packFont("/font.bin");
+  SdService sd;
+  GlyphCache glyphs(sd, "/font.bin");
+  CHECK(glyphs.begin());
+  TextLayout layout;
+  layout.setTextSize(1);
+  layout.setGlyphs(&glyphs);
+
+  // 6 for ASCII and é, 8 for 中, the box of the widest ASCII for 😀
+  string text = "a\xc3\xa9\xe4\xb8\xad\xf0\x9f\x98\x80";
+  CHECK(layout.width(text.data(), text.size()) == 6 + 6 + 8 + 6);
+}
@@ -0,0 +1,31 @@
+#include "test.h"
+#include "utf8.h"
+
+TEST(utf8DecodesEachLength) {
+  std::string text = "a\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80";
+  size_t i = 0;
+  CHECK(utf8Next(text.data(), text.size(), i) == 'a');
+  CHECK(utf8Next(text.data(), text.size(), i) == 0xe9);
+  CHECK(utf8Next(text.data(), text.size(), i) == 0x20ac);
+  CHECK(utf8Next(text.data(), text.size(), i) == 0x1f600);
+  CHECK(i == text.size());
+}
+
+TEST(utf8MalformedTakesOneByte) {
+  std::string text = "\x80z\xc3";
+  size_t i = 0;
+  CHECK(utf8Next(text.data(), text.size(), i) == UTF8_INVALID);
+  CHECK(i == 1);
+  CHECK(utf8Next(text.data(), text.size(), i) == 'z');
+  // cut short at the end
+  CHECK(utf8Next(text.data(), text.size(), i) == UTF8_INVALID);
+  CHECK(i == 3);
+}
+
+TEST(utf8StepsBack) {
+  std::string text = "a\xe2\x82\xac";
+  CHECK(utf8Previous(text.data(), text.size()) == 1);
+  CHECK(utf8Previous(text.data(), 1) == 0);
+  utf8PopBack(text);
+  CHECK(text == "a");
+}
@@ -0,0 +1,107 @@
+#!/usr/bin/env python3
+"""Packs the non-ASCII glyphs of a BDF bitmap font into mjfont.bin.
+
+Copy the output to the root of the SD card as /mjfont.bin. Fonts close to
+8 pixels high match the terminal's built-in font best.
+
+    python3 tools/pack_font.py font.bdf mjfont.bin [--ranges 0080-024F,0370-03FF]
+"""
+
+import argparse
+import struct
+import sys
+
+
+def parse_bdf(path):
+    """Yields (codepoint, width, rows) with rows as lists of bits, top first."""
+    ascent = descent = None
+    glyph = None
+    with open(path, encoding="latin-1") as f:
+        lines = iter(f)
+        for line in lines:
+            words = line.split()
+            if not words:
+                continue
+            key = words[0]
+            if key == "FONT_ASCENT":
+                ascent = int(words[1])
+            elif key == "FONT_DESCENT":
+                descent = int(words[1])
+            elif key == "STARTCHAR":
+                glyph = {}
+            elif key == "ENCODING" and glyph is not None:
+                glyph["codepoint"] = int(words[1])
+            elif key == "DWIDTH" and glyph is not None:
+                glyph["advance"] = int(words[1])
+            elif key == "BBX" and glyph is not None:
+                glyph["bbx"] = [int(w) for w in words[1:5]]
+            elif key == "BITMAP" and glyph is not None:
+                w, h, xoff, yoff = glyph["bbx"]
+                height = ascent + descent
+                advance = max(glyph.get("advance", w), 1)
+                rows = [[0] * advance for _ in range(height)]
+                top = ascent - (h + yoff)
+                for y in range(h):
+                    bits = int(next(lines).strip() or "0", 16)
+                    nbits = ((w + 7) // 8) * 8
+                    for x in range(w):
+                        if bits >> (nbits - 1 - x) & 1:
+                            px, py = x + xoff, y + top
+                            if 0 <= px < advance and 0 <= py < height:
+                                rows[py][px] = 1
+                if glyph.get("codepoint", -1) >= 0x80:
+                    yield glyph["codepoint"], advance, rows
+                glyph = None
+    if ascent is None or descent is None:
+        sys.exit("font has no FONT_ASCENT / FONT_DESCENT")
+
+
+def parse_ranges(text):
+    ranges = []
+    for part in text.split(","):
+        low, _, high = part.partition("-")
+        ranges.append((int(low, 16), int(high or low, 16)))
+    return ranges
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("bdf")
+    parser.add_argument("output")
+    parser.add_argument("--ranges", help="hex codepoint ranges to keep")
+    args = parser.parse_args()
+
+    ranges = parse_ranges(args.ranges) if args.ranges else None
+    glyphs = sorted(
+        g
+        for g in parse_bdf(args.bdf)
+        if ranges is None or any(low <= g[0] <= high for low, high in ranges)
+    )
+    if not glyphs:
+        sys.exit("no glyphs above U+007F")
+    height = len(glyphs[0][2])
+    if any(g[1] > 255 for g in glyphs):
+        sys.exit("glyphs wider than 255 pixels are not supported")
+
+    header = b"MJF1" + struct.pack("<B3xI", height, len(glyphs))
+    offset = len(header) + 8 * len(glyphs)
+    index = bytearray()
+    data = bytearray()
+    for codepoint, width, rows in glyphs:
+        index += struct.pack("<II", codepoint, offset + len(data))
+        data.append(width)
+        for row in rows:
+            padded = row + [0] * (-len(row) % 8)
+            for i in range(0, len(padded), 8):
+                byte = 0
+                for bit in padded[i:i + 8]:
+                    byte = byte << 1 | bit
+                data.append(byte)
+
+    with open(args.output, "wb") as f:
+        f.write(header + index + data)
+    print("%d glyphs, %d px high, %d bytes" % (len(glyphs), height, len(header) + len(index) + len(data)))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,140 @@
+#!/usr/bin/env python3
+"""Packs an RGB565 image into the palette and run length format of src/packedimage.h.
+
+The input is a PNG (needs Pillow), a C header holding a raw uint16_t RGB565
+array with _WIDTH and _HEIGHT defines, or an already packed header or .bin.
+The output is a C header for flash, a .bin for the SD card, or a PNG to edit.
+
+    python3 tools/pack_image.py logo.png src/MessageJarCardputerLogo.h --name MessageJarLogo
+    python3 tools/pack_image.py logo.png mjlogo.bin
+
+A .bin copied to the root of the SD card as /mjlogo.bin replaces the boot logo.
+"""
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+MAGIC = b"MJI1"
+MAX_RUN = 256  # a run's length is stored less one in a byte
+MAX_WIDTH = 240  # IMAGE_MAX_WIDTH in src/packedimage.h
+
+
+def pack(width, height, pixels):
+    """Header, palette, then (palette index, length - 1) byte pairs."""
+    palette = []
+    index = {}
+    for color in pixels:
+        if color not in index:
+            index[color] = len(palette)
+            palette.append(color)
+    if len(palette) > 256:
+        sys.exit(f"{len(palette)} colors, at most 256 fit the palette")
+
+    runs = bytearray()
+    i = 0
+    while i < len(pixels):
+        color = pixels[i]
+        length = 1
+        while i + length < len(pixels) and length < MAX_RUN and pixels[i + length] == color:
+            length += 1
+        runs += bytes((index[color], length - 1))
+        i += length
+
+    header = MAGIC + struct.pack("<HHBB", width, height, len(palette) - 1, 0)
+    return header + struct.pack(f"<{len(palette)}H", *palette) + bytes(runs)
+
+
+def unpack(data):
+    if data[:4] != MAGIC:
+        sys.exit("not a packed image")
+    width, height, colors, _ = struct.unpack_from("<HHBB", data, 4)
+    colors += 1
+    palette = struct.unpack_from(f"<{colors}H", data, 10)
+    pixels = []
+    for at in range(10 + colors * 2, len(data) - 1, 2):
+        pixels += [palette[data[at]]] * (data[at + 1] + 1)
+    if len(pixels) != width * height:
+        sys.exit("packed image is cut short")
+    return width, height, pixels
+
+
+def read_header(path):
+    text = open(path).read()
+    values = re.findall(r"0x[0-9a-fA-F]+", text.split("{", 1)[-1])
+    if "uint8_t" in text.split("{", 1)[0]:
+        return unpack(bytes(int(v, 16) for v in values))
+    width = re.search(r"_WIDTH\s+(\d+)", text)
+    height = re.search(r"_HEIGHT\s+(\d+)", text)
+    if not width or not height:
+        sys.exit("header has no _WIDTH / _HEIGHT defines")
+    return int(width.group(1)), int(height.group(1)), [int(v, 16) for v in values]
+
+
+def read_png(path):
+    from PIL import Image
+
+    image = Image.open(path).convert("RGB")
+    pixels = [(r >> 3) << 11 | (g >> 2) << 5 | b >> 3 for r, g, b in image.getdata()]
+    return image.width, image.height, pixels
+
+
+def write_png(path, width, height, pixels):
+    from PIL import Image
+
+    image = Image.new("RGB", (width, height))
+    image.putdata([((c >> 11) * 255 // 31, (c >> 5 & 63) * 255 // 63, (c & 31) * 255 // 31)
+                   for c in pixels])
+    image.save(path)
+
+
+def write_header(path, name, source, width, height, data):
+    lines = [f"// Generated by tools/pack_image.py from {os.path.basename(source)}, do not edit",
+             f"#define {name.upper()}_HEIGHT {height}",
+             f"#define {name.upper()}_WIDTH {width}",
+             "",
+             f"// {len(data)} bytes packed, {width * height * 2} unpacked, see src/packedimage.h",
+             f"static const uint8_t {name}[] PROGMEM = {{"]
+    for at in range(0, len(data), 16):
+        lines.append("  " + ", ".join(f"0x{b:02x}" for b in data[at:at + 16]) + ",")
+    lines.append("};")
+    with open(path, "w") as f:
+        f.write("\n".join(lines) + "\n")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("input", help=".png, .h or .bin")
+    parser.add_argument("output", help=".h, .bin or .png")
+    parser.add_argument("--name", default="MessageJarLogo", help="array name in a .h output")
+    args = parser.parse_args()
+
+    extension = os.path.splitext(args.input)[1].lower()
+    if extension == ".h":
+        width, height, pixels = read_header(args.input)
+    elif extension == ".bin":
+        width, height, pixels = unpack(open(args.input, "rb").read())
+    else:
+        width, height, pixels = read_png(args.input)
+    if len(pixels) != width * height:
+        sys.exit(f"{len(pixels)} pixels for a {width}x{height} image")
+    if width > MAX_WIDTH:
+        sys.exit(f"wider than the {MAX_WIDTH} pixel screen")
+
+    data = pack(width, height, pixels)
+    extension = os.path.splitext(args.output)[1].lower()
+    if extension == ".h":
+        write_header(args.output, args.name, args.input, width, height, data)
+    elif extension == ".bin":
+        with open(args.output, "wb") as f:
+            f.write(data)
+    else:
+        write_png(args.output, width, height, pixels)
+    print(f"{width}x{height}, {len(data)} bytes packed, {width * height * 2} unpacked")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
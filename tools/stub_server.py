@@ -0,0 +1,544 @@
+#!/usr/bin/env python3
+"""A stand-in Message Jar server for measuring how the client sends.
+
+It answers every endpoint of src/endpoints.h with a canned reply. Point a
+profile's "server" at it, queue messages while offline and let them flush.
+Each burst of sends is summed up as messages, requests and time taken. The
+device only talks HTTPS, so pass a certificate and key:
+
+    python3 tools/stub_server.py --cert cert.pem --key key.pem [--no-batch]
+
+--latency adds a delay to every answer, to stand in for the real round trip.
+--fault makes a share (--fault-rate) of requests time out, answer 503 or
+have their connection reset, to watch retries and the circuit breaker.
+--history fills the room with that many messages for /get to answer with,
+and --gzip compresses answers for clients that accept it, reporting the
+bytes on the wire against the bytes decoded for every /get.
+Messages sent to the stub join its one room. --long-poll holds a /get that
+asks to wait until a message arrives, --sse streams them from /stream,
+without either the client falls back to plain polling. Every minute each
+mode in use is reported as requests per hour and delivery latency, the
+time a message sat in the room before it went out to a client. --chatter
+posts a message of varying length every that many seconds, for soak runs.
+--bench skips the device and times 1, 10 and 100 queued messages sent one by
+one over a kept connection against sent in batches, in the request pattern
+the outbox uses, then fetches the history with and without compression. It
+measures Python's http.client against the stub, with Nagle's algorithm off,
+so it compares request counts, bytes and round trips, not the firmware's
+own timings. It then runs a polling client, and a long polling and a
+streaming one when the stub offers them, against a sender for a while each.
+Over HTTPS it also times a request on a new connection with a full
+handshake, with a resumed TLS session and on a kept connection, the cases
+behind the connects and connections_reused counters.
+The stub refuses to start when the paths it answers differ from ENDPOINTS
+in src/endpoints.h, --check only compares them.
+"""
+
+import argparse
+import gzip
+import http.client
+import http.server
+import itertools
+import json
+import os
+import random
+import re
+import socket
+import ssl
+import struct
+import sys
+import threading
+import time
+
+BATCH = 20  # OUTBOX_BATCH in src/outbox.h
+BURST_GAP = 2.0  # seconds of quiet that end a burst
+TICKS = 1.0  # seconds between polls, TICKS in src/transport.h
+LONG_POLL_WAIT = 20  # seconds, LONG_POLL_WAIT in src/transport.h
+KEEPALIVE = 5.0  # seconds between comments on an idle event stream
+REPORT_EVERY = 60.0  # seconds between delivery reports
+
+ENDPOINTS_H = os.path.normpath(os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                                            "..", "src", "endpoints.h"))
+# Answered in do_POST
+HANDLED = {"/get", "/stream", "/send", "/send/batch"}
+# What every other endpoint of ENDPOINTS in src/endpoints.h answers
+ANSWERS = {
+    "/token/username": {"username": "stub"},
+    "/user/new": {},
+    "/user/exists": {"exists": True},
+    "/user/generate": {"token": "stub-token"},
+    "/token/revoke": {},
+    "/rooms/list": ["stub"],
+    "/rooms/create": {},
+}
+
+
+def check_endpoints(path=ENDPOINTS_H):
+    """The paths of ENDPOINTS in `path` the stub does not answer, and the
+    ones it answers that are not there."""
+    with open(path) as header:
+        source = header.read()
+    table = source[source.index("Endpoint ENDPOINTS[]"):]
+    paths = set(re.findall(r'\{"(/[^"]*)"', table[:table.index("};")]))
+    known = set(ANSWERS) | HANDLED
+    return sorted(paths - known), sorted(known - paths)
+
+
+def fixture(count):
+    """A room's history of `count` made up messages."""
+    words = ["the", "weather", "meeting", "lunch", "code", "review", "again", "soon"]
+    return [{"author": f"user{i % 7}",
+             "content": " ".join(words[(i * k) % len(words)] for k in range(1, 9)),
+             "created": f"2024-05-{i % 28 + 1:02} 12:{i % 60:02}",
+             "id": str(i)}
+            for i in range(count)]
+
+
+class Room:
+    """The stub's one room. Messages sent to it wake the requests waiting
+    for them, each remembers when it arrived."""
+
+    def __init__(self, history):
+        self.cond = threading.Condition()
+        self.messages = list(history)
+        self.arrived = [None] * len(self.messages)
+
+    def add(self, content):
+        with self.cond:
+            self.messages.append({"author": "stub", "content": content,
+                                  "created": time.strftime("%Y-%m-%d %H:%M"),
+                                  "id": str(len(self.messages))})
+            self.arrived.append(time.monotonic())
+            self.cond.notify_all()
+
+    def since(self, latest, wait=0):
+        """Messages after the first `latest` and when each arrived, waiting
+        up to `wait` seconds for one when there are none."""
+        with self.cond:
+            self.cond.wait_for(lambda: len(self.messages) > latest, timeout=wait)
+            return self.messages[latest:], self.arrived[latest:]
+
+
+class Deliveries:
+    """Per transport mode, the requests for new messages and how long each
+    message waited in the room before it was sent out."""
+
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.reset()
+
+    def reset(self):
+        self.start = time.monotonic()
+        self.modes = {}
+
+    def request(self, mode):
+        with self.lock:
+            self.modes.setdefault(mode, [0, []])[0] += 1
+
+    def delivered(self, mode, arrivals):
+        now = time.monotonic()
+        with self.lock:
+            latencies = self.modes.setdefault(mode, [0, []])[1]
+            latencies.extend((now - a) * 1000 for a in arrivals if a is not None)
+
+    def report(self, every=0.0):
+        """A line per mode and starts over, once `every` seconds passed."""
+        with self.lock:
+            seconds = time.monotonic() - self.start
+            if seconds < every or not self.modes:
+                return
+            for mode, (requests, latencies) in sorted(self.modes.items()):
+                line = (f"{mode:9} {requests:4} request(s) in {seconds:.0f} s, "
+                        f"{requests * 3600 / seconds:6.0f} per hour")
+                if latencies:
+                    line += (f", {len(latencies)} delivered, latency mean "
+                             f"{sum(latencies) / len(latencies):.0f} ms, "
+                             f"max {max(latencies):.0f} ms")
+                print(line)
+            self.reset()
+
+
+class Stats:
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.reset()
+
+    def reset(self):
+        self.messages = self.requests = 0
+        self.first = self.last = None
+
+    def record(self, messages):
+        with self.lock:
+            now = time.monotonic()
+            if self.first is None:
+                self.first = now
+            self.last = now
+            self.messages += messages
+            self.requests += 1
+
+    def report(self):
+        with self.lock:
+            if self.first is None or time.monotonic() - self.last < BURST_GAP:
+                return
+            ms = (self.last - self.first) * 1000
+            print(f"{self.messages} message(s) in {self.requests} request(s), {ms:.0f} ms")
+            self.reset()
+
+
+def make_handler(stats, batch, latency, fault, fault_rate, compress, room, deliveries,
+                 long_poll, sse):
+    class Handler(http.server.BaseHTTPRequestHandler):
+        protocol_version = "HTTP/1.1"  # keep connections open like the real one
+        disable_nagle_algorithm = True  # headers and body are separate writes
+
+        def log_message(self, format, *args):
+            pass
+
+        def answer(self, code, body):
+            """Sends `body` as JSON, gzipped when allowed. Returns the bytes
+            on the wire and the bytes of JSON."""
+            data = json.dumps(body).encode()
+            decoded = len(data)
+            encoded = compress and "gzip" in self.headers.get("Accept-Encoding", "")
+            if encoded:
+                data = gzip.compress(data)
+            time.sleep(latency / 1000)
+            self.send_response(code)
+            self.send_header("Content-Type", "application/json")
+            if encoded:
+                self.send_header("Content-Encoding", "gzip")
+            self.send_header("Content-Length", str(len(data)))
+            self.end_headers()
+            self.wfile.write(data)
+            return len(data), decoded
+
+        def inject(self):
+            """Fails this request as --fault says, True when it did."""
+            if not fault or random.random() >= fault_rate:
+                return False
+            print(f"{fault} on {self.path}")
+            if fault == "timeout":
+                time.sleep(60)  # past every client timeout
+                self.close_connection = True
+            elif fault == "5xx":
+                self.answer(503, {"e": "unavailable"})
+            elif fault == "reset":
+                # RST instead of FIN
+                self.connection.setsockopt(socket.SOL_SOCKET, socket.SO_LINGER,
+                                           struct.pack("ii", 1, 0))
+                self.close_connection = True
+            return True
+
+        def do_POST(self):
+            length = int(self.headers.get("Content-Length", 0))
+            body = json.loads(self.rfile.read(length) or b"{}")
+            path = self.path.split("/api/v1", 1)[-1]
+            if self.inject():
+                return
+
+            if path == "/send":
+                stats.record(1)
+                room.add(body.get("message", ""))
+                self.answer(200, {})
+            elif path == "/send/batch" and batch:
+                stats.record(len(body.get("messages", [])))
+                for message in body.get("messages", []):
+                    room.add(message.get("message", ""))
+                self.answer(200, {})
+            elif path == "/get":
+                # without --long-poll the wait is ignored, as an older server
+                # does, and the client falls back to plain polling
+                wait = int(body.get("wait", 0)) if long_poll else 0
+                mode = "long-poll" if wait else "poll"
+                deliveries.request(mode)
+                messages, arrivals = room.since(int(body.get("latest", 0)), wait)
+                # each message a JSON encoded string, like the real server
+                wire, decoded = self.answer(200, [json.dumps(m) for m in messages])
+                deliveries.delivered(mode, arrivals)
+                if compress and messages:
+                    print(f"/get {len(messages)} message(s), {wire} bytes on the wire, "
+                          f"{decoded} decoded ({decoded / wire:.1f}x)")
+            elif path == "/stream" and sse:
+                deliveries.request("sse")
+                self.stream(int(body.get("latest", 0)))
+            elif path in ANSWERS:
+                self.answer(200, ANSWERS[path])
+            else:
+                # /stream without --sse, the client falls back to polling
+                self.answer(404, {"e": "not found"})
+
+        def stream(self, latest):
+            """Server sent events, one message each, until the client goes."""
+            self.send_response(200)
+            self.send_header("Content-Type", "text/event-stream")
+            self.send_header("Cache-Control", "no-cache")
+            self.end_headers()
+            self.close_connection = True
+            try:
+                while True:
+                    messages, arrivals = room.since(latest, KEEPALIVE)
+                    if not messages:
+                        # a comment, writing it notices a client that left
+                        self.wfile.write(b": keepalive\n\n")
+                        self.wfile.flush()
+                        continue
+                    time.sleep(latency / 1000)
+                    for message in messages:
+                        self.wfile.write(f"data: {json.dumps(message)}\n\n".encode())
+                    self.wfile.flush()
+                    latest += len(messages)
+                    deliveries.delivered("sse", arrivals)
+            except OSError:
+                pass
+
+    return Handler
+
+
+def connect(port, secure):
+    if secure:
+        context = ssl._create_unverified_context()
+        conn = http.client.HTTPSConnection("127.0.0.1", port, context=context)
+    else:
+        conn = http.client.HTTPConnection("127.0.0.1", port)
+    # headers and body go out as separate writes, without this each request
+    # waits on a delayed ACK
+    conn.connect()
+    conn.sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+    return conn
+
+
+def handshakes(port, rounds=20):
+    """Mean ms of a request that pays for a full handshake, a resumed one
+    and none, over TLS 1.2 like the device's mbedTLS."""
+    context = ssl._create_unverified_context()
+    context.maximum_version = ssl.TLSVersion.TLSv1_2
+    body = json.dumps({"token": "t"})
+
+    def open_conn(session=None):
+        sock = socket.create_connection(("127.0.0.1", port))
+        sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        conn = http.client.HTTPConnection("127.0.0.1", port)
+        conn.sock = context.wrap_socket(sock, session=session)
+        return conn
+
+    def request(conn):
+        conn.request("POST", "/api/v1/token/username", body,
+                     {"Content-Type": "application/json"})
+        conn.getresponse().read()
+
+    session = None
+    resumed = 0
+    kept = open_conn()
+    for case in ("full", "resumed", "kept"):
+        start = time.monotonic()
+        for _ in range(rounds):
+            if case == "kept":
+                request(kept)
+                continue
+            conn = open_conn(session if case == "resumed" else None)
+            request(conn)
+            if case == "full":
+                session = conn.sock.session
+            else:
+                resumed += conn.sock.session_reused
+            conn.close()
+        ms = (time.monotonic() - start) * 1000 / rounds
+        note = f" ({resumed}/{rounds} resumed)" if case == "resumed" else ""
+        label = {"full": "full handshake", "resumed": "resumed session",
+                 "kept": "kept connection"}[case]
+        print(f"request with a {label:15} {ms:6.2f} ms{note}")
+    kept.close()
+
+
+def transports(port, secure, modes, seconds, room, deliveries):
+    """Runs a client of each mode for `seconds` while messages are sent at
+    random gaps of 0.5 to 3 s, reporting what the stub saw."""
+    rng = random.Random(1)
+
+    def client(mode, stop, latest):
+        conn = connect(port, secure)
+        path = "/api/v1/stream" if mode == "sse" else "/api/v1/get"
+        while not stop.is_set():
+            body = {"token": "t", "room": "stub", "latest": latest}
+            if mode == "long-poll":
+                body["wait"] = LONG_POLL_WAIT
+            started = time.monotonic()
+            conn.request("POST", path, json.dumps(body),
+                         {"Content-Type": "application/json"})
+            response = conn.getresponse()
+            if mode == "sse":
+                # the stream runs until the bench ends
+                while not stop.is_set() and response.fp.readline():
+                    pass
+                break
+            latest += len(json.loads(response.read()))
+            # the transports leave at least TICKS between request starts
+            time.sleep(max(0.0, TICKS - (time.monotonic() - started)))
+        conn.close()
+
+    for mode in modes:
+        stop = threading.Event()
+        deliveries.reset()
+        # from the end of the room, like a client that is caught up
+        threading.Thread(target=client, args=(mode, stop, len(room.messages)),
+                         daemon=True).start()
+        sender = connect(port, secure)
+        end = time.monotonic() + seconds
+        sent = 0
+        while time.monotonic() < end:
+            time.sleep(rng.uniform(0.5, 3.0))
+            sender.request("POST", "/api/v1/send",
+                           json.dumps({"token": "t", "room": "stub", "message": f"m{sent}"}),
+                           {"Content-Type": "application/json"})
+            sender.getresponse().read()
+            sent += 1
+        time.sleep(TICKS + 0.2)  # the last message's poll
+        deliveries.report()
+        # one more message ends a long poll still held, the client then stops
+        stop.set()
+        sender.request("POST", "/api/v1/send",
+                       json.dumps({"token": "t", "room": "stub", "message": "end"}),
+                       {"Content-Type": "application/json"})
+        sender.getresponse().read()
+        sender.close()
+        time.sleep(0.2)
+
+
+def bench(port, secure, history, modes, seconds, room, deliveries):
+    """Times queued messages sent singly and batched against a running stub,
+    then a full history fetch with and without compression."""
+    for count in (1, 10, 100):
+        for batched in (False, True):
+            conn = connect(port, secure)
+            step = BATCH if batched and count > 1 else 1
+            start = time.monotonic()
+            requests = 0
+            failed = 0
+            for first in range(0, count, step):
+                messages = [{"room": "stub", "message": f"message {i}"}
+                            for i in range(first, min(count, first + step))]
+                if step == 1:
+                    path, body = "/send", dict(messages[0], token="t")
+                else:
+                    path, body = "/send/batch", {"token": "t", "messages": messages}
+                conn.request("POST", "/api/v1" + path, json.dumps(body),
+                             {"Content-Type": "application/json"})
+                response = conn.getresponse()
+                response.read()
+                requests += 1
+                if response.status != 200:
+                    failed += 1
+            ms = (time.monotonic() - start) * 1000
+            conn.close()
+            mode = "batched" if batched else "one by one"
+            result = f", {failed} failed ({response.status})" if failed else ""
+            print(f"{count:3} message(s) {mode:10} {requests:3} request(s) {ms:7.1f} ms{result}")
+
+    transports(port, secure, modes, seconds, room, deliveries)
+
+    if secure:
+        handshakes(port)
+
+    if not history:
+        return
+    for encoding in ("identity", "gzip"):
+        conn = connect(port, secure)
+        start = time.monotonic()
+        conn.request("POST", "/api/v1/get", json.dumps({"token": "t", "room": "stub", "latest": 0}),
+                     {"Content-Type": "application/json", "Accept-Encoding": encoding})
+        response = conn.getresponse()
+        data = response.read()
+        wire = len(data)
+        if response.getheader("Content-Encoding") == "gzip":
+            data = gzip.decompress(data)
+        ms = (time.monotonic() - start) * 1000
+        conn.close()
+        count = len(json.loads(data))
+        print(f"history of {count} {encoding:8} {wire:7} bytes on the wire, "
+              f"{len(data):7} decoded, {ms:6.1f} ms")
+
+
+def chatter(room, every):
+    """Posts a message to `room` every `every` seconds, from one word to a
+    few hundred bytes, so polls keep parsing answers of every size."""
+    words = fixture(1)[0]["content"].split()
+    for i in itertools.count():
+        time.sleep(every)
+        room.add(" ".join(words[k % len(words)] for k in range(1 + i * 7 % 60)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--port", type=int, default=8443)
+    parser.add_argument("--cert", help="PEM certificate, serves HTTPS with --key")
+    parser.add_argument("--key", help="PEM private key")
+    parser.add_argument("--no-batch", action="store_true",
+                        help="answer /send/batch with 404 like an older server")
+    parser.add_argument("--latency", type=int, default=0, help="ms added to every answer")
+    parser.add_argument("--fault", choices=["timeout", "5xx", "reset"],
+                        help="how injected failures fail")
+    parser.add_argument("--fault-rate", type=float, default=1.0,
+                        help="share of requests that fail, 1 is a dead server")
+    parser.add_argument("--history", type=int, default=0,
+                        help="messages in the room that /get answers with")
+    parser.add_argument("--gzip", action="store_true",
+                        help="compress answers for clients that accept gzip")
+    parser.add_argument("--long-poll", action="store_true",
+                        help="hold a /get until a message arrives, when it asks to wait")
+    parser.add_argument("--sse", action="store_true",
+                        help="stream messages from /stream as server sent events")
+    parser.add_argument("--chatter", type=float, default=0,
+                        help="seconds between messages the stub posts itself")
+    parser.add_argument("--bench", action="store_true",
+                        help="time sends against this stub instead of serving a device")
+    parser.add_argument("--bench-seconds", type=float, default=30,
+                        help="how long --bench runs each transport mode")
+    parser.add_argument("--check", action="store_true",
+                        help="compare the paths answered with src/endpoints.h and exit")
+    args = parser.parse_args()
+
+    if args.check or os.path.exists(ENDPOINTS_H):
+        missing, extra = check_endpoints()
+        if missing or extra:
+            sys.exit(f"out of step with {ENDPOINTS_H}: not answered {missing}, "
+                     f"answered but not there {extra}")
+        if args.check:
+            print(f"answers every endpoint of {ENDPOINTS_H}")
+            return 0
+
+    stats = Stats()
+    room = Room(fixture(args.history))
+    deliveries = Deliveries()
+    server = http.server.ThreadingHTTPServer(
+        ("", args.port),
+        make_handler(stats, not args.no_batch, args.latency, args.fault, args.fault_rate,
+                     args.gzip, room, deliveries, args.long_poll, args.sse))
+    server.daemon_threads = True  # held polls and streams do not block exit
+    secure = bool(args.cert and args.key)
+    if secure:
+        context = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+        context.load_cert_chain(args.cert, args.key)
+        server.socket = context.wrap_socket(server.socket, server_side=True)
+
+    threading.Thread(target=server.serve_forever, daemon=True).start()
+    if args.chatter and not args.bench:
+        threading.Thread(target=chatter, args=(room, args.chatter), daemon=True).start()
+    if args.bench:
+        modes = ["poll"] + (["long-poll"] if args.long_poll else []) + (["sse"] if args.sse else [])
+        bench(args.port, secure, args.history, modes, args.bench_seconds, room,
+              deliveries)
+        return 0
+
+    scheme = "https" if secure else "http"
+    print(f"serving on {scheme}://0.0.0.0:{args.port}/api/v1")
+    try:
+        while True:
+            time.sleep(0.5)
+            stats.report()
+            deliveries.report(REPORT_EVERY)
+    except KeyboardInterrupt:
+        return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())